@@ -4,6 +4,10 @@
 
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -16,4 +20,51 @@ std::string readFileContents(std::string path)
     return buffer.str();
 }
 
+// resolves ".", ".." and symlinks so the same file always yields the same key,
+// paths that don't exist are returned unchanged
+inline std::string canonicalPath(const std::string &path)
+{
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) != nullptr)
+	return resolved;
+    return path;
+}
+
+// 64-bit FNV-1a, used to key on-disk caches by content. Pass a previous result
+// as seed to hash several buffers as one.
+const uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+inline uint64_t hashBytes(const void *data, size_t size,
+			  uint64_t seed = HASH_SEED)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+	hash ^= bytes[i];
+	hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// resident memory of the process in KiB, now and at its peak, read from
+// /proc/self/status. Fields stay 0 where that file is not available.
+struct MemoryUsage {
+    size_t residentKiB = 0;
+    size_t peakResidentKiB = 0;
+};
+
+inline MemoryUsage readMemoryUsage()
+{
+    MemoryUsage usage;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+	if (line.compare(0, 6, "VmRSS:") == 0)
+	    usage.residentKiB = std::strtoul(line.c_str() + 6, nullptr, 10);
+	else if (line.compare(0, 6, "VmHWM:") == 0)
+	    usage.peakResidentKiB = std::strtoul(line.c_str() + 6, nullptr, 10);
+    }
+    return usage;
+}
+
 #endif // PROJECT_BASE_COMMON_H
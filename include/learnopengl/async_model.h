@@ -0,0 +1,99 @@
+#ifndef ASYNC_MODEL_H
+#define ASYNC_MODEL_H
+
+#include <learnopengl/model.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+// handle to a model that is imported in the background. Parsing, vertex
+// conversion and texture decoding run on a loader thread; Update() is called
+// once per frame on the render thread and creates the GL objects a few meshes
+// at a time, so frames keep being presented while the model streams in.
+class AsyncModel
+{
+  public:
+    AsyncModel(const string &path, bool gamma = false,
+	       ModelOptions options = ModelOptions())
+	: model(new Model(gamma, options))
+    {
+	worker = std::thread([this, path]() {
+	    model->importModel(path);
+	    imported = true;
+	});
+    }
+
+    // wraps a model that is already loaded
+    explicit AsyncModel(shared_ptr<Model> loaded)
+	: model(std::move(loaded)), imported(true), ready(true)
+    {
+    }
+
+    AsyncModel(const AsyncModel &) = delete;
+    AsyncModel &operator=(const AsyncModel &) = delete;
+
+    ~AsyncModel()
+    {
+	if (worker.joinable())
+	    worker.join();
+    }
+
+    // render thread: uploads up to meshesPerFrame meshes once the import is
+    // done. Returns true when the model is ready to draw.
+    bool Update(size_t meshesPerFrame = 4)
+    {
+	if (ready)
+	    return true;
+	if (!imported)
+	    return false;
+	if (worker.joinable())
+	    worker.join();
+	if (uploadStart == StartupTimeline::Clock::time_point())
+	    uploadStart = StartupTimeline::Clock::now();
+	ready = model->uploadPending(meshesPerFrame);
+	if (ready)
+	    StartupTimeline::Instance().Add("upload " + model->directory,
+					    uploadStart,
+					    StartupTimeline::Clock::now());
+	return ready;
+    }
+
+    // render thread: blocks until the model is imported and fully uploaded
+    void Finish()
+    {
+	if (worker.joinable())
+	    worker.join();
+	imported = true;
+	Update(SIZE_MAX);
+    }
+
+    bool Ready() const { return ready; }
+
+    // 0 while importing, then grows with the uploaded meshes up to 1
+    float Progress() const
+    {
+	if (ready)
+	    return 1.0f;
+	if (!imported)
+	    return 0.0f;
+	size_t total = model->pendingMeshes.size();
+	return 0.5f + 0.5f * model->meshes.size() / (total ? total : 1);
+    }
+
+    // the loaded model, nullptr until Ready()
+    shared_ptr<Model> Get() const { return ready ? model : nullptr; }
+
+  private:
+    friend class ModelCache;
+
+    shared_ptr<Model> model;
+    std::thread worker;
+    std::atomic<bool> imported{false};
+    StartupTimeline::Clock::time_point uploadStart; // first Update after import
+    bool ready = false;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+
+// axis-aligned box, empty (min > max) until a point is added
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool IsEmpty() const { return min.x > max.x; }
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    void Extend(const glm::vec3 &point)
+    {
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+    }
+    void Extend(const AABB &box)
+    {
+	min = glm::min(min, box.min);
+	max = glm::max(max, box.max);
+    }
+};
+
+// sphere around the same geometry, negative radius when empty
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = -1.0f;
+
+    bool IsEmpty() const { return radius < 0.0f; }
+
+    // grows to the smallest sphere holding both
+    void Extend(const BoundingSphere &sphere)
+    {
+	if (sphere.IsEmpty())
+	    return;
+	if (IsEmpty()) {
+	    *this = sphere;
+	    return;
+	}
+	glm::vec3 offset = sphere.center - center;
+	float distance = glm::length(offset);
+	if (distance + sphere.radius <= radius)
+	    return;
+	if (distance + radius <= sphere.radius) {
+	    *this = sphere;
+	    return;
+	}
+	float grown = (distance + radius + sphere.radius) * 0.5f;
+	center += offset * ((grown - radius) / distance);
+	radius = grown;
+    }
+};
+
+// box and sphere of one piece of geometry. The sphere rejects most of what
+// is far outside the frustum with one dot product per plane, the box is
+// tighter for what remains.
+struct Bounds {
+    AABB box;
+    BoundingSphere sphere;
+
+    bool IsEmpty() const { return box.IsEmpty(); }
+
+    void Extend(const Bounds &bounds)
+    {
+	box.Extend(bounds.box);
+	sphere.Extend(bounds.sphere);
+    }
+
+    // the bounds after transform, still axis aligned so a rotated box
+    // grows to hold the rotated corners
+    Bounds Transformed(const glm::mat4 &transform) const
+    {
+	Bounds result;
+	if (IsEmpty())
+	    return result;
+	// Arvo: each output axis takes the smaller and larger product of every
+	// matrix entry with the box's extent on that input axis
+	glm::vec3 translation(transform[3]);
+	result.box.min = result.box.max = translation;
+	for (int column = 0; column < 3; column++) {
+	    for (int row = 0; row < 3; row++) {
+		float a = transform[column][row] * box.min[column];
+		float b = transform[column][row] * box.max[column];
+		result.box.min[row] += std::min(a, b);
+		result.box.max[row] += std::max(a, b);
+	    }
+	}
+	float scale = std::max(std::max(glm::length(glm::vec3(transform[0])),
+					glm::length(glm::vec3(transform[1]))),
+			       glm::length(glm::vec3(transform[2])));
+	result.sphere.center =
+	    glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+	result.sphere.radius = sphere.radius * scale;
+	return result;
+    }
+};
+
+// bounds of count vertices with a glm::vec3 Position: the box and a sphere
+// centered on it that reaches the farthest vertex
+template <typename V> Bounds BoundsOf(const V *vertices, size_t count)
+{
+    Bounds bounds;
+    for (size_t i = 0; i < count; i++)
+	bounds.box.Extend(vertices[i].Position);
+    if (bounds.IsEmpty())
+	return bounds;
+    bounds.sphere.center = bounds.box.Center();
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+	glm::vec3 offset = vertices[i].Position - bounds.sphere.center;
+	radius2 = std::max(radius2, glm::dot(offset, offset));
+    }
+    bounds.sphere.radius = std::sqrt(radius2);
+    return bounds;
+}
+
+// the six planes of a view-projection matrix, normals pointing inwards, so
+// a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // zero planes, every non-empty bounds intersects them
+    static Frustum Everything()
+    {
+	Frustum frustum;
+	for (glm::vec4 &plane : frustum.planes)
+	    plane = glm::vec4(0.0f);
+	return frustum;
+    }
+
+    // Gribb and Hartmann: the clip-space conditions -w <= x, y, z <= w are
+    // sums and differences of the matrix rows
+    static Frustum FromMatrix(const glm::mat4 &viewProjection)
+    {
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+	    rows[row] =
+		glm::vec4(viewProjection[0][row], viewProjection[1][row],
+			  viewProjection[2][row], viewProjection[3][row]);
+	Frustum frustum;
+	for (int axis = 0; axis < 3; axis++) {
+	    frustum.planes[axis * 2] = rows[3] + rows[axis];
+	    frustum.planes[axis * 2 + 1] = rows[3] - rows[axis];
+	}
+	for (glm::vec4 &plane : frustum.planes)
+	    plane /= glm::length(glm::vec3(plane));
+	return frustum;
+    }
+
+    bool Intersects(const BoundingSphere &sphere) const
+    {
+	for (const glm::vec4 &plane : planes)
+	    if (glm::dot(glm::vec3(plane), sphere.center) + plane.w <
+		-sphere.radius)
+		return false;
+	return true;
+    }
+
+    // tests the corner of the box farthest along each plane's normal
+    bool Intersects(const AABB &box) const
+    {
+	for (const glm::vec4 &plane : planes) {
+	    glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x,
+			     plane.y >= 0.0f ? box.max.y : box.min.y,
+			     plane.z >= 0.0f ? box.max.z : box.min.z);
+	    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+		return false;
+	}
+	return true;
+    }
+
+    // conservative: true for some bounds just outside a frustum corner
+    bool Intersects(const Bounds &bounds) const
+    {
+	return !bounds.IsEmpty() && Intersects(bounds.sphere) &&
+	       Intersects(bounds.box);
+    }
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/bounds.h>
+
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to
@@ -70,6 +72,12 @@ class Camera
 	return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // the view frustum seen through projection, in world space
+    Frustum GetFrustum(const glm::mat4 &projection)
+    {
+	return Frustum::FromMatrix(projection * GetViewMatrix());
+    }
+
     // processes input received from any keyboard-like input system. Accepts
     // input parameter in the form of camera defined ENUM (to abstract it from
     // windowing systems)
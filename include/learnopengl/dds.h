@@ -0,0 +1,203 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// minimal DDS container support: block-compressed 2D textures (BC1, BC3,
+// BC4, BC5, BC7) with a precomputed mip chain. tools/texture_compress writes
+// these from the PNG/JPEG sources.
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+const uint32_t DDSD_CAPS = 0x1;
+const uint32_t DDSD_HEIGHT = 0x2;
+const uint32_t DDSD_WIDTH = 0x4;
+const uint32_t DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8;
+const uint32_t DDSCAPS_TEXTURE = 0x1000;
+const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+struct DDSPixelFormat {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t rBitMask;
+    uint32_t gBitMask;
+    uint32_t bBitMask;
+    uint32_t aBitMask;
+};
+
+struct DDSHeader {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DDSPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct DDSHeaderDX10 {
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header layout");
+static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header layout");
+
+inline constexpr uint32_t DDSFourCC(char a, char b, char c, char d)
+{
+    return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) |
+	   ((uint32_t)d << 24);
+}
+
+// a parsed DDS file: one GL format and the byte range of each mip level
+struct DDSImage {
+    struct Level {
+	int width;
+	int height;
+	size_t offset;
+	size_t size;
+    };
+
+    GLenum format = 0;
+    int blockBytes = 0;
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+
+    bool IsValid() const { return format != 0 && !levels.empty(); }
+    size_t Bytes() const { return data.size(); }
+};
+
+inline size_t DDSLevelSize(int width, int height, int blockBytes)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+// parses a DDS file held in memory, returns an invalid image for anything
+// that isn't a supported block-compressed 2D texture.
+inline DDSImage ParseDDS(const unsigned char *bytes, size_t size)
+{
+    DDSImage image;
+    uint32_t magic;
+    DDSHeader header;
+    if (size < sizeof(magic) + sizeof(header))
+	return image;
+    std::memcpy(&magic, bytes, sizeof(magic));
+    std::memcpy(&header, bytes + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(DDSHeader) ||
+	!(header.pixelFormat.flags & DDPF_FOURCC))
+	return image;
+
+    size_t offset = sizeof(magic) + sizeof(header);
+    switch (header.pixelFormat.fourCC) {
+    case DDSFourCC('D', 'X', 'T', '1'):
+	image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	image.blockBytes = 8;
+	break;
+    case DDSFourCC('D', 'X', 'T', '5'):
+	image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	image.blockBytes = 16;
+	break;
+    case DDSFourCC('A', 'T', 'I', '1'):
+    case DDSFourCC('B', 'C', '4', 'U'):
+	image.format = GL_COMPRESSED_RED_RGTC1;
+	image.blockBytes = 8;
+	break;
+    case DDSFourCC('A', 'T', 'I', '2'):
+    case DDSFourCC('B', 'C', '5', 'U'):
+	image.format = GL_COMPRESSED_RG_RGTC2;
+	image.blockBytes = 16;
+	break;
+    case DDSFourCC('D', 'X', '1', '0'): {
+	DDSHeaderDX10 dx10;
+	if (size < offset + sizeof(dx10))
+	    return image;
+	std::memcpy(&dx10, bytes + offset, sizeof(dx10));
+	offset += sizeof(dx10);
+	switch (dx10.dxgiFormat) {
+	case 71: // DXGI_FORMAT_BC1_UNORM
+	    image.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	    image.blockBytes = 8;
+	    break;
+	case 77: // DXGI_FORMAT_BC3_UNORM
+	    image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	    image.blockBytes = 16;
+	    break;
+	case 80: // DXGI_FORMAT_BC4_UNORM
+	    image.format = GL_COMPRESSED_RED_RGTC1;
+	    image.blockBytes = 8;
+	    break;
+	case 83: // DXGI_FORMAT_BC5_UNORM
+	    image.format = GL_COMPRESSED_RG_RGTC2;
+	    image.blockBytes = 16;
+	    break;
+	case 98: // DXGI_FORMAT_BC7_UNORM
+	    image.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+	    image.blockBytes = 16;
+	    break;
+	default:
+	    return image;
+	}
+	break;
+    }
+    default:
+	return image;
+    }
+
+    int width = (int)header.width;
+    int height = (int)header.height;
+    unsigned int levelCount =
+	(header.flags & DDSD_MIPMAPCOUNT) && header.mipMapCount > 0
+	    ? header.mipMapCount
+	    : 1;
+    size_t dataStart = offset;
+    for (unsigned int i = 0; i < levelCount && width > 0 && height > 0;
+	 i++) {
+	size_t levelSize = DDSLevelSize(width, height, image.blockBytes);
+	if (offset + levelSize > size)
+	    break;
+	image.levels.push_back(
+	    {width, height, offset - dataStart, levelSize});
+	offset += levelSize;
+	if (width == 1 && height == 1)
+	    break;
+	width = width > 1 ? width / 2 : 1;
+	height = height > 1 ? height / 2 : 1;
+    }
+    if (image.levels.empty()) {
+	image.format = 0;
+	return image;
+    }
+    image.data.assign(bytes + dataStart, bytes + offset);
+    return image;
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile, the ARB variant uses the same values
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+
+// entry points of ARB_get_program_binary, null when unsupported
+struct ProgramBinaryFunctions {
+    typedef void(APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize,
+					     GLsizei *length,
+					     GLenum *binaryFormat,
+					     void *binary);
+    typedef void(APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat,
+					  const void *binary, GLsizei length);
+    typedef void(APIENTRYP ProgramParameteri)(GLuint program, GLenum pname,
+					      GLint value);
+
+    GetProgramBinary getProgramBinary = nullptr;
+    ProgramBinary programBinary = nullptr;
+    ProgramParameteri programParameteri = nullptr;
+
+    bool IsSupported() const
+    {
+	return getProgramBinary && programBinary && programParameteri;
+    }
+};
+
+// the glad loader is generated for core 3.3 without extensions, so optional
+// features are detected here. Call GLExtensions::Init() once after glad is
+// loaded, with the same proc address loader; afterwards the flags are
+// read-only and safe to read from loader threads.
+class GLExtensions
+{
+  public:
+    // BC1/BC3 (DXT1/DXT5)
+    static bool &S3TC()
+    {
+	static bool supported = false;
+	return supported;
+    }
+    // BC7
+    static bool &BPTC()
+    {
+	static bool supported = false;
+	return supported;
+    }
+
+    // compiles and links run on driver threads; glCompileShader and
+    // glLinkProgram return at once and only status queries wait for them
+    static bool &ParallelShaderCompile()
+    {
+	static bool supported = false;
+	return supported;
+    }
+
+    // program binaries, only set when the driver also offers at least one
+    // binary format
+    static ProgramBinaryFunctions &ProgramBinaries()
+    {
+	static ProgramBinaryFunctions functions;
+	return functions;
+    }
+
+    static void Init(GLADloadproc load)
+    {
+	S3TC() = Has("GL_EXT_texture_compression_s3tc");
+	BPTC() = Has("GL_ARB_texture_compression_bptc");
+
+	// let the driver pick the number of compiler threads
+	typedef void(APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+	MaxShaderCompilerThreads maxShaderCompilerThreads = nullptr;
+	if (Has("GL_KHR_parallel_shader_compile"))
+	    maxShaderCompilerThreads = (MaxShaderCompilerThreads)load(
+		"glMaxShaderCompilerThreadsKHR");
+	else if (Has("GL_ARB_parallel_shader_compile"))
+	    maxShaderCompilerThreads = (MaxShaderCompilerThreads)load(
+		"glMaxShaderCompilerThreadsARB");
+	ParallelShaderCompile() = maxShaderCompilerThreads != nullptr;
+	if (maxShaderCompilerThreads)
+	    maxShaderCompilerThreads(0xFFFFFFFF);
+
+	GLint formats = 0;
+	if (Has("GL_ARB_get_program_binary"))
+	    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats > 0) {
+	    ProgramBinaryFunctions &binaries = ProgramBinaries();
+	    binaries.getProgramBinary =
+		(ProgramBinaryFunctions::GetProgramBinary)load(
+		    "glGetProgramBinary");
+	    binaries.programBinary =
+		(ProgramBinaryFunctions::ProgramBinary)load("glProgramBinary");
+	    binaries.programParameteri =
+		(ProgramBinaryFunctions::ProgramParameteri)load(
+		    "glProgramParameteri");
+	}
+    }
+
+    static bool Has(const char *name)
+    {
+	static std::unordered_set<std::string> extensions = []() {
+	    std::unordered_set<std::string> names;
+	    GLint count = 0;
+	    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	    for (GLint i = 0; i < count; i++)
+		names.insert(
+		    (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i));
+	    return names;
+	}();
+	return extensions.count(name) > 0;
+    }
+};
+
+#endif
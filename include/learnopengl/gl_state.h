@@ -0,0 +1,200 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// fixed-function state of a render pass. Passes declare one as a constant
+// and hand it to GLState::Apply, which only issues what differs from the
+// current state.
+struct PipelineState {
+    bool depthTest = true;
+    GLenum depthFunc = GL_LESS;
+    bool depthWrite = true; // note that glClear honours the depth mask
+    bool blend = false;
+    GLenum blendSrc = GL_SRC_ALPHA;
+    GLenum blendDst = GL_ONE_MINUS_SRC_ALPHA;
+    bool cullFace = false;
+    GLenum cullMode = GL_BACK;
+
+    // builders, so descriptors can be declared const in one expression
+    PipelineState DepthTest(bool enabled, GLenum func = GL_LESS) const
+    {
+	PipelineState state = *this;
+	state.depthTest = enabled;
+	state.depthFunc = func;
+	return state;
+    }
+    PipelineState DepthWrite(bool enabled) const
+    {
+	PipelineState state = *this;
+	state.depthWrite = enabled;
+	return state;
+    }
+    PipelineState Blend(GLenum src, GLenum dst) const
+    {
+	PipelineState state = *this;
+	state.blend = true;
+	state.blendSrc = src;
+	state.blendDst = dst;
+	return state;
+    }
+    PipelineState Cull(GLenum mode) const
+    {
+	PipelineState state = *this;
+	state.cullFace = true;
+	state.cullMode = mode;
+	return state;
+    }
+};
+
+// shadow of the GL state the renderer changes. Binds and enables go through
+// it so that calls which would not change anything are skipped. Code that
+// changes the same state directly (resource creation, ImGui) must call
+// Invalidate() afterwards, the next call of each kind is then issued.
+class GLState
+{
+  public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+    // calls issued to the driver and skipped as redundant
+    struct Counters {
+	unsigned int issued = 0;
+	unsigned int elided = 0;
+    };
+
+    static GLState &Instance()
+    {
+	static GLState state;
+	return state;
+    }
+
+    void UseProgram(GLuint program)
+    {
+	if (track(program, currentProgram))
+	    glUseProgram(program);
+    }
+
+    void BindVertexArray(GLuint vao)
+    {
+	if (track(vao, currentVAO))
+	    glBindVertexArray(vao);
+    }
+
+    void BindFramebuffer(GLuint fbo)
+    {
+	if (track(fbo, currentFramebuffer))
+	    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    }
+
+    // binds texture to target on a texture unit, selecting the unit first if
+    // needed. Only the last target bound on a unit is remembered, switching
+    // targets on one unit costs a call but never skips one.
+    void BindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+	if (unit >= MAX_TEXTURE_UNITS) {
+	    glActiveTexture(GL_TEXTURE0 + unit);
+	    glBindTexture(target, texture);
+	    activeUnit = UNKNOWN;
+	    counters.issued += 2;
+	    return;
+	}
+	TextureBinding &binding = textures[unit];
+	if (binding.target == target && binding.texture == texture) {
+	    counters.elided++;
+	    return;
+	}
+	if (track(unit, activeUnit))
+	    glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, texture);
+	counters.issued++;
+	binding.target = target;
+	binding.texture = texture;
+    }
+
+    // brings the fixed-function state to pipeline, issuing only the
+    // differences
+    void Apply(const PipelineState &pipeline)
+    {
+	if (track(pipeline.depthTest, depthTest))
+	    enable(GL_DEPTH_TEST, pipeline.depthTest);
+	if (pipeline.depthTest && track(pipeline.depthFunc, depthFunc))
+	    glDepthFunc(pipeline.depthFunc);
+	if (track(pipeline.depthWrite, depthWrite))
+	    glDepthMask(pipeline.depthWrite ? GL_TRUE : GL_FALSE);
+	if (track(pipeline.blend, blend))
+	    enable(GL_BLEND, pipeline.blend);
+	if (pipeline.blend) {
+	    // one call sets both factors
+	    GLuint factors = (pipeline.blendSrc << 16) ^ pipeline.blendDst;
+	    if (track(factors, blendFactors))
+		glBlendFunc(pipeline.blendSrc, pipeline.blendDst);
+	}
+	if (track(pipeline.cullFace, cullFace))
+	    enable(GL_CULL_FACE, pipeline.cullFace);
+	if (pipeline.cullFace && track(pipeline.cullMode, cullMode))
+	    glCullFace(pipeline.cullMode);
+    }
+
+    // forgets everything, the next call of each kind reaches the driver
+    void Invalidate()
+    {
+	currentProgram = currentVAO = currentFramebuffer = activeUnit = UNKNOWN;
+	for (TextureBinding &binding : textures)
+	    binding = TextureBinding();
+	depthTest = depthWrite = blend = cullFace = UNKNOWN;
+	depthFunc = blendFactors = cullMode = UNKNOWN;
+    }
+
+    // closes a frame: the counters of the frame become LastFrame() and
+    // counting starts over
+    void EndFrame()
+    {
+	lastFrame = counters;
+	counters = Counters();
+    }
+
+    const Counters &LastFrame() const { return lastFrame; }
+
+  private:
+    // a value no real GL name or enum takes, for "not known"
+    static const GLuint UNKNOWN = ~0u;
+
+    struct TextureBinding {
+	GLenum target = UNKNOWN;
+	GLuint texture = UNKNOWN;
+    };
+
+    GLuint currentProgram = UNKNOWN;
+    GLuint currentVAO = UNKNOWN;
+    GLuint currentFramebuffer = UNKNOWN;
+    GLuint activeUnit = UNKNOWN;
+    TextureBinding textures[MAX_TEXTURE_UNITS];
+    GLuint depthTest = UNKNOWN, depthWrite = UNKNOWN, blend = UNKNOWN,
+	   cullFace = UNKNOWN;
+    GLenum depthFunc = UNKNOWN, blendFactors = UNKNOWN, cullMode = UNKNOWN;
+    Counters counters, lastFrame;
+
+    GLState() = default;
+
+    // records value as current, returns true if the call has to be issued
+    template <typename T> bool track(T value, GLuint &current)
+    {
+	if (current == (GLuint)value) {
+	    counters.elided++;
+	    return false;
+	}
+	current = (GLuint)value;
+	counters.issued++;
+	return true;
+    }
+
+    static void enable(GLenum capability, bool enabled)
+    {
+	if (enabled)
+	    glEnable(capability);
+	else
+	    glDisable(capability);
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file. The mapping is released when the
+// object goes out of scope, so pointers into data() must not outlive it.
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path) { Open(path); }
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool Open(const std::string &path)
+    {
+	Close();
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	    return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+	    void *ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ,
+			     MAP_PRIVATE, fd, 0);
+	    if (ptr != MAP_FAILED) {
+		mapping = ptr;
+		length = (size_t)st.st_size;
+	    }
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+	return mapping != nullptr;
+    }
+
+    void Close()
+    {
+	if (mapping)
+	    munmap(mapping, length);
+	mapping = nullptr;
+	length = 0;
+    }
+
+    bool IsOpen() const { return mapping != nullptr; }
+    const unsigned char *data() const
+    {
+	return static_cast<const unsigned char *>(mapping);
+    }
+    size_t size() const { return length; }
+
+  private:
+    void *mapping = nullptr;
+    size_t length = 0;
+};
+
+#endif
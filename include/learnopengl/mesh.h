@@ -6,8 +6,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/bounds.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 using namespace std;
@@ -23,6 +30,185 @@ struct Vertex {
     glm::vec3 Tangent;
     // bitangent
     glm::vec3 Bitangent;
+
+    static constexpr std::array<VertexAttribute, 5> Attributes()
+    {
+	return {{VERTEX_ATTRIBUTE(Vertex, Position, 0),
+		 VERTEX_ATTRIBUTE(Vertex, Normal, 1),
+		 VERTEX_ATTRIBUTE(Vertex, TexCoords, 2),
+		 VERTEX_ATTRIBUTE(Vertex, Tangent, 3),
+		 VERTEX_ATTRIBUTE(Vertex, Bitangent, 4)}};
+    }
+};
+
+static_assert(VertexAttributeBytes<Vertex>() == sizeof(Vertex),
+	      "Vertex must have no padding");
+
+// vertex attributes as a mask, bit n for the attribute at location n. The
+// same bits come back from Shader::ActiveAttributes().
+const unsigned int VERTEX_POSITION = 1u << 0;
+const unsigned int VERTEX_NORMAL = 1u << 1;
+const unsigned int VERTEX_TEXCOORDS = 1u << 2;
+const unsigned int VERTEX_TANGENT = 1u << 3;
+const unsigned int VERTEX_BITANGENT = 1u << 4;
+const unsigned int VERTEX_ALL_ATTRIBUTES = (1u << 5) - 1;
+const unsigned int VERTEX_ATTRIBUTE_COUNT = 5;
+
+// GPU vertex formats a mesh can be uploaded with. Float uploads Vertex as is
+// (56 bytes). Packed uploads PackedVertex (24 bytes): half-float texture
+// coordinates, normal and tangent as normalized 10_10_10_2 with the
+// bitangent handedness in the tangent's w, so the shader can rebuild the
+// bitangent as cross(normal, tangent.xyz) * sign(tangent.w). The sign, not
+// w itself: GL 3.3 converts signed normalized values as (2c + 1) / (2^b - 1),
+// so the 2-bit -1 arrives as -1/3 (see PackSnorm1010102).
+enum class VertexFormat { Float, Packed };
+
+// members in attribute location order, like Vertex
+struct PackedVertex {
+    glm::vec3 Position;
+    Snorm1010102 Normal; // w is unused
+    Half2 TexCoords;
+    Snorm1010102 Tangent; // w holds the bitangent handedness
+
+    // no bitangent stream, location 4 is left disabled
+    static constexpr std::array<VertexAttribute, 4> Attributes()
+    {
+	return {{VERTEX_ATTRIBUTE(PackedVertex, Position, 0),
+		 VERTEX_ATTRIBUTE(PackedVertex, Normal, 1),
+		 VERTEX_ATTRIBUTE(PackedVertex, TexCoords, 2),
+		 VERTEX_ATTRIBUTE(PackedVertex, Tangent, 3)}};
+    }
+};
+
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must be 24 bytes");
+static_assert(VertexAttributeBytes<PackedVertex>() == sizeof(PackedVertex),
+	      "PackedVertex must have no padding");
+
+// a vertex format restricted to the attributes the shaders read. Attributes
+// left out are neither uploaded nor enabled, the rest are interleaved in
+// location order. With all attributes the layout is Vertex or PackedVertex.
+struct VertexLayout {
+    VertexFormat format;
+    unsigned int attributes;
+
+    VertexLayout(VertexFormat format = VertexFormat::Float,
+		 unsigned int attributes = VERTEX_ALL_ATTRIBUTES)
+	: format(format), attributes(attributes | VERTEX_POSITION)
+    {
+    }
+
+    bool Has(unsigned int location) const
+    {
+	return (attributes >> location) & 1;
+    }
+
+    // the attribute at location as the format's vertex struct describes
+    // it, with bytes 0 if the format has no stream for it (the packed
+    // bitangent)
+    VertexAttribute Attribute(unsigned int location) const
+    {
+	return format == VertexFormat::Packed
+		   ? FindVertexAttribute<PackedVertex>(location)
+		   : FindVertexAttribute<Vertex>(location);
+    }
+
+    size_t AttributeSize(unsigned int location) const
+    {
+	return Attribute(location).bytes;
+    }
+
+    // byte offset of the attribute at location within a vertex
+    size_t Offset(unsigned int location) const
+    {
+	size_t offset = 0;
+	for (unsigned int i = 0; i < location; i++)
+	    if (Has(i))
+		offset += AttributeSize(i);
+	return offset;
+    }
+
+    size_t Stride() const { return Offset(VERTEX_ATTRIBUTE_COUNT); }
+};
+
+// packs a vector with components in [-1, 1] and w in {-1, 1} for
+// GL_INT_2_10_10_10_REV with normalization. Only the sign of w survives the
+// conversion of a 3.3 context, which decodes the stored -1 as -1/3 (4.2+
+// clamps it to -1); shaders read it as sign(w).
+inline uint32_t PackSnorm1010102(const glm::vec3 &v, float w)
+{
+    auto snorm = [](float f, float scale, uint32_t mask) {
+	int i = (int)std::lround(std::min(std::max(f, -1.0f), 1.0f) * scale);
+	return (uint32_t)i & mask;
+    };
+    return snorm(v.x, 511.0f, 0x3ff) | (snorm(v.y, 511.0f, 0x3ff) << 10) |
+	   (snorm(v.z, 511.0f, 0x3ff) << 20) | (snorm(w, 1.0f, 0x3) << 30);
+}
+
+// IEEE 754 binary16, round to nearest, for GL_HALF_FLOAT attributes
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff) // inf / nan
+	return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31) // overflow
+	return (uint16_t)(sign | 0x7c00);
+    if (exponent <= 0) { // subnormal or zero
+	if (exponent < -10)
+	    return (uint16_t)sign;
+	mantissa |= 0x800000;
+	uint32_t shift = (uint32_t)(14 - exponent);
+	uint32_t half = mantissa >> shift;
+	if ((mantissa >> (shift - 1)) & 1)
+	    half++;
+	return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) // round, may carry into the exponent
+	half++;
+    return (uint16_t)half;
+}
+
+inline PackedVertex PackVertex(const Vertex &vertex)
+{
+    PackedVertex packed;
+    packed.Position = vertex.Position;
+    packed.Normal.bits = PackSnorm1010102(vertex.Normal, 0.0f);
+    float handedness =
+	glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) <
+		0.0f
+	    ? -1.0f
+	    : 1.0f;
+    packed.Tangent.bits = PackSnorm1010102(vertex.Tangent, handedness);
+    packed.TexCoords.x = FloatToHalf(vertex.TexCoords.x);
+    packed.TexCoords.y = FloatToHalf(vertex.TexCoords.y);
+    return packed;
+}
+
+// 16-bit indices address this many vertices
+const size_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+
+// smallest index type that can address vertexCount vertices
+inline GLenum IndexTypeFor(size_t vertexCount)
+{
+    return vertexCount <= SHORT_INDEX_VERTEX_LIMIT ? GL_UNSIGNED_SHORT
+						   : GL_UNSIGNED_INT;
+}
+
+inline size_t IndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+					  : sizeof(uint32_t);
+}
+
+// CPU copy of the geometry a Mesh keeps after uploading it
+enum class GeometryRetention {
+    Keep,      // all vertices and indices
+    Positions, // positions and indices only, enough for picking
+    None       // nothing, the GPU buffers are the only copy
 };
 
 struct Texture {
@@ -31,80 +217,366 @@ struct Texture {
     string path;
 };
 
+// CPU-side geometry and material references of a mesh, produced by an import
+// (on any thread) and turned into a Mesh on the GL thread.
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<Texture> textures;
+    Bounds bounds; // of the vertices, in model space
+};
+
+// first of the five attribute locations InstanceData occupies: four for the
+// transform columns and one for the bob parameters
+const GLuint INSTANCE_ATTRIBUTE_LOCATION = 5;
+
+// per-instance data of an instanced draw, read by the vertex shader from
+// locations INSTANCE_ATTRIBUTE_LOCATION.. with a divisor of 1, see
+// SetupVertexAttributes
+struct InstanceData {
+    glm::mat4 transform;
+    float bobPhase;	// the instance bobs by bobAmplitude * sin(time + phase)
+    float bobAmplitude; // along world y, 0 keeps it still
+
+    // a mat4 attribute takes one location per column; phase and amplitude
+    // arrive together as a vec2
+    static constexpr std::array<VertexAttribute, 5> Attributes()
+    {
+	return {{MakeVertexAttribute<glm::vec4>(
+		     INSTANCE_ATTRIBUTE_LOCATION,
+		     offsetof(InstanceData, transform)),
+		 MakeVertexAttribute<glm::vec4>(
+		     INSTANCE_ATTRIBUTE_LOCATION + 1,
+		     offsetof(InstanceData, transform) + sizeof(glm::vec4)),
+		 MakeVertexAttribute<glm::vec4>(
+		     INSTANCE_ATTRIBUTE_LOCATION + 2,
+		     offsetof(InstanceData, transform) + 2 * sizeof(glm::vec4)),
+		 MakeVertexAttribute<glm::vec4>(
+		     INSTANCE_ATTRIBUTE_LOCATION + 3,
+		     offsetof(InstanceData, transform) + 3 * sizeof(glm::vec4)),
+		 MakeVertexAttribute<glm::vec2>(INSTANCE_ATTRIBUTE_LOCATION + 4,
+						offsetof(InstanceData,
+							 bobPhase))}};
+    }
+};
+
+static_assert(VertexAttributeBytes<InstanceData>() == sizeof(InstanceData),
+	      "InstanceData must have no padding");
+
+// where a mesh lives inside vertex and index buffers shared by a model
+struct SharedMeshRange {
+    GLint baseVertex = 0; // first vertex of the mesh
+    size_t firstIndex = 0;
+    GLenum indexType = GL_UNSIGNED_INT; // of the whole shared index buffer
+};
+
+// texture types a mesh binds, the N-th texture of the i-th type is sampled
+// as <prefix><type>N from unit i + MATERIAL_TEXTURE_TYPE_COUNT * (N - 1).
+// Every mesh uses the same unit for the same sampler name, so a program's
+// sampler uniforms are set once, when a mesh is baked against it. Up to
+// MATERIAL_TEXTURES_PER_TYPE textures of a type get a unit; the units above
+// stay free for other bindings (see TRANSFORM_BUFFER_UNIT).
+const char *const MATERIAL_TEXTURE_TYPES[] = {
+    "texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+const unsigned int MATERIAL_TEXTURE_TYPE_COUNT = 4;
+const unsigned int MATERIAL_TEXTURES_PER_TYPE = 3;
+
+// everything Mesh::Draw needs, resolved once against a shader program so
+// drawing does no string building, name lookups or allocations
+struct DrawPacket {
+    struct Sampler {
+	GLint unit;
+	unsigned int texture;
+    };
+
+    unsigned int program = 0; // baked against, 0 when it must be rebaked
+    vector<Sampler> samplers; // only those the program samples
+    unsigned int VAO = 0; // 0 when drawing from a model's shared VAO
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    const void *indexOffset = nullptr;
+    GLint baseVertex = 0;
+};
+
 class Mesh
 {
   public:
-    // mesh Data
+    // mesh Data, what is left of the geometry depends on GeometryRetention
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
+    // positions for picking when only those are retained
+    vector<glm::vec3> positions;
+    // model-space bounds, kept whatever the geometry retention
+    Bounds bounds;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
+    unsigned int VAO = 0;
+    // layout of the vertex buffer on the GPU
+    VertexLayout layout;
+    // element type and count of the index buffer on the GPU
+    GLenum indexType = GL_UNSIGNED_INT;
+    unsigned int indexCount = 0;
+    unsigned int vertexCount = 0;
+    // set when the mesh draws from its model's buffers instead of its own
+    bool sharedBuffers = false;
+    GLint baseVertex = 0;
+    size_t indexOffset = 0; // in bytes
+    // constructor, takes ownership of the geometry; move the vectors in to
+    // avoid copying them
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices,
-	 vector<Texture> textures)
+	 vector<Texture> textures, VertexLayout layout = VertexLayout(),
+	 GeometryRetention retention = GeometryRetention::Keep)
+	: vertices(std::move(vertices)), indices(std::move(indices)),
+	  textures(std::move(textures)), layout(layout)
     {
-	this->vertices = vertices;
-	this->indices = indices;
-	this->textures = textures;
-
 	// now that we have all the required data, set the vertex buffers and
 	// its attribute pointers.
-	setupMesh();
+	setupMesh(this->vertices.data(), this->vertices.size(),
+		  this->indices.data(), this->indices.size());
+
+	switch (retention) {
+	case GeometryRetention::Keep:
+	    break;
+	case GeometryRetention::Positions:
+	    keepPositions(this->vertices.data(), this->vertices.size());
+	    vector<Vertex>().swap(this->vertices);
+	    break;
+	case GeometryRetention::None:
+	    vector<Vertex>().swap(this->vertices);
+	    vector<unsigned int>().swap(this->indices);
+	    break;
+	}
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
-    {
-	// bind appropriate textures
-	unsigned int diffuseNr = 1;
-	unsigned int specularNr = 1;
-	unsigned int normalNr = 1;
-	unsigned int heightNr = 1;
-	for (unsigned int i = 0; i < textures.size(); i++) {
-	    glActiveTexture(GL_TEXTURE0 +
-			    i); // active proper texture unit before binding
+    // constructor for geometry that is already laid out for upload (e.g. a
+    // memory-mapped mesh cache), the buffers are filled straight from it.
+    Mesh(const Vertex *vertexData, size_t vertexCount,
+	 const unsigned int *indexData, size_t indexCount,
+	 vector<Texture> textures, VertexLayout layout = VertexLayout(),
+	 GeometryRetention retention = GeometryRetention::Keep)
+	: textures(std::move(textures)), layout(layout)
+    {
+	setupMesh(vertexData, vertexCount, indexData, indexCount);
+	retain(vertexData, vertexCount, indexData, indexCount, retention);
+    }
+
+    // constructor for a mesh stored in buffers shared by its whole model.
+    // The model's VAO must be bound; the geometry is written into its
+    // buffers at range and drawn with a base vertex, see Model.
+    Mesh(const Vertex *vertexData, size_t vertexCount,
+	 const unsigned int *indexData, size_t indexCount,
+	 vector<Texture> textures, const SharedMeshRange &range,
+	 VertexLayout layout = VertexLayout(),
+	 GeometryRetention retention = GeometryRetention::Keep)
+	: textures(std::move(textures)), layout(layout),
+	  indexType(range.indexType), indexCount((unsigned int)indexCount),
+	  vertexCount((unsigned int)vertexCount), sharedBuffers(true),
+	  baseVertex(range.baseVertex),
+	  indexOffset(range.firstIndex * IndexSize(range.indexType))
+    {
+	WriteVertices(layout, vertexData, vertexCount,
+		      range.baseVertex * layout.Stride());
+	WriteIndices(indexType, indexData, indexCount, indexOffset);
+	retain(vertexData, vertexCount, indexData, indexCount, retention);
+    }
+
+    // a mesh owns GL objects, it is moved into place but never copied
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+
+    // points the sampler uniforms of this mesh's textures in shader at
+    // their units (see MATERIAL_TEXTURE_TYPES) and records what Draw binds.
+    // Leaves shader in use. Draw calls it again whenever the shader's
+    // program or the name prefix changes.
+    void Bake(Shader &shader)
+    {
+	// sampler units are program state, set through the shader so its
+	// shadow copies stay current
+	shader.use();
+	packet.program = shader.ID;
+	packet.samplers.clear();
+	packet.samplers.reserve(textures.size());
+	// we assume a convention for sampler names in the shaders, the N-th
+	// texture of a type is bound to <prefix><type>N
+	unsigned int count[MATERIAL_TEXTURE_TYPE_COUNT] = {};
+	for (const Texture &texture : textures) {
+	    unsigned int type = 0;
+	    while (type < MATERIAL_TEXTURE_TYPE_COUNT &&
+		   texture.type != MATERIAL_TEXTURE_TYPES[type])
+		type++;
+	    if (type == MATERIAL_TEXTURE_TYPE_COUNT ||
+		count[type] == MATERIAL_TEXTURES_PER_TYPE)
+		continue; // no unit for it
 	    // retrieve texture number (the N in diffuse_textureN)
-	    string number;
-	    string name = textures[i].type;
-	    if (name == "texture_diffuse")
-		number = std::to_string(diffuseNr++);
-	    else if (name == "texture_specular")
-		number = std::to_string(
-		    specularNr++); // transfer unsigned int to stream
-	    else if (name == "texture_normal")
-		number = std::to_string(
-		    normalNr++); // transfer unsigned int to stream
-	    else if (name == "texture_height")
-		number = std::to_string(
-		    heightNr++); // transfer unsigned int to stream
-
-	    // now set the sampler to the correct texture unit
-	    glUniform1i(
-		glGetUniformLocation(
-		    shader.ID, (glslIdentifierPrefix + name + number).c_str()),
-		i);
-	    // and finally bind the texture
-	    glBindTexture(GL_TEXTURE_2D, textures[i].id);
+	    unsigned int number = ++count[type];
+	    string name =
+		glslIdentifierPrefix + texture.type + std::to_string(number);
+	    // textures the program doesn't sample aren't bound
+	    if (glGetUniformLocation(shader.ID, name.c_str()) < 0)
+		continue;
+	    DrawPacket::Sampler sampler;
+	    sampler.unit =
+		(GLint)(type + MATERIAL_TEXTURE_TYPE_COUNT * (number - 1));
+	    sampler.texture = texture.id;
+	    shader.setInt(name, sampler.unit);
+	    packet.samplers.push_back(sampler);
 	}
 
-	// draw mesh
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	packet.VAO = sharedBuffers ? 0 : VAO;
+	packet.indexCount = (GLsizei)indexCount;
+	packet.indexType = indexType;
+	packet.indexOffset = (const void *)indexOffset;
+	packet.baseVertex = baseVertex;
+    }
+
+    // render the mesh
+    void Draw(Shader &shader) { DrawInstanced(shader, 0); }
+
+    // sampler names are looked up as <prefix><type>N, e.g. "material."
+    void SetShaderTextureNamePrefix(const std::string &prefix)
+    {
+	if (prefix == glslIdentifierPrefix)
+	    return;
+	glslIdentifierPrefix = prefix;
+	packet.program = 0; // rebaked by the next draw
+    }
+
+    // makes the mesh current for drawing with shader: bakes the packet if
+    // needed, binds the textures and the mesh's own VAO. A mesh in shared
+    // buffers relies on its model having bound the shared VAO. The VAO is
+    // left bound, the next draw rebinds only if it needs another one.
+    void Bind(Shader &shader)
+    {
+	if (packet.program != shader.ID)
+	    Bake(shader);
+
+	// bind appropriate textures, units already holding them are skipped.
+	// The samplers were pointed at the units by Bake.
+	GLState &state = GLState::Instance();
+	for (const DrawPacket::Sampler &sampler : packet.samplers)
+	    state.BindTexture(sampler.unit, GL_TEXTURE_2D, sampler.texture);
+	if (packet.VAO)
+	    state.BindVertexArray(packet.VAO);
+    }
 
-	// always good practice to set everything back to defaults once
-	// configured.
-	glActiveTexture(GL_TEXTURE0);
+    // renders instanceCount instances in one call, the instance attributes
+    // must be set up on the VAO (see Model::DrawInstanced). 0 draws once
+    // without instancing.
+    void DrawInstanced(Shader &shader, GLsizei instanceCount)
+    {
+	Bind(shader);
+	if (instanceCount > 0)
+	    glDrawElementsInstancedBaseVertex(
+		GL_TRIANGLES, packet.indexCount, packet.indexType,
+		packet.indexOffset, instanceCount, packet.baseVertex);
+	else if (packet.VAO)
+	    glDrawElements(GL_TRIANGLES, packet.indexCount, packet.indexType,
+			   packet.indexOffset);
+	else
+	    glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount,
+				     packet.indexType, packet.indexOffset,
+				     packet.baseVertex);
+    }
+
+    // frees the GPU buffers, the mesh must not be drawn afterwards
+    void Release()
+    {
+	if (sharedBuffers)
+	    return; // owned by the model
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+    }
+
+    // writes vertices in the given layout into the bound GL_ARRAY_BUFFER
+    static void WriteVertices(const VertexLayout &layout,
+			      const Vertex *vertexData, size_t vertexCount,
+			      size_t byteOffset)
+    {
+	if (layout.format == VertexFormat::Packed ||
+	    layout.attributes != VERTEX_ALL_ATTRIBUTES) {
+	    vector<unsigned char> encoded(vertexCount * layout.Stride());
+	    for (size_t i = 0; i < vertexCount; i++)
+		encodeVertex(layout, vertexData[i],
+			     encoded.data() + i * layout.Stride());
+	    glBufferSubData(GL_ARRAY_BUFFER, byteOffset, encoded.size(),
+			    encoded.data());
+	} else {
+	    // A great thing about structs is that their memory layout is
+	    // sequential for all its items. The effect is that we can simply
+	    // pass a pointer to the struct and it translates perfectly to a
+	    // glm::vec3/2 array which again translates to 3/2 floats which
+	    // translates to a byte array.
+	    glBufferSubData(GL_ARRAY_BUFFER, byteOffset,
+			    vertexCount * sizeof(Vertex), vertexData);
+	}
+    }
+
+    // writes indices as indexType into the bound GL_ELEMENT_ARRAY_BUFFER
+    static void WriteIndices(GLenum indexType, const unsigned int *indexData,
+			     size_t indexCount, size_t byteOffset)
+    {
+	if (indexType == GL_UNSIGNED_SHORT) {
+	    vector<uint16_t> shortIndices(indexData, indexData + indexCount);
+	    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, byteOffset,
+			    indexCount * sizeof(uint16_t), shortIndices.data());
+	} else {
+	    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, byteOffset,
+			    indexCount * sizeof(unsigned int), indexData);
+	}
+    }
+
+    // sets the vertex attribute pointers of the bound VAO for a layout.
+    // Types come from the format's vertex struct; normalized attributes
+    // arrive in the shader as floats, so shaders need no changes for either
+    // format.
+    static void SetupAttributes(const VertexLayout &layout)
+    {
+	for (GLuint location = 0; location < VERTEX_ATTRIBUTE_COUNT;
+	     location++) {
+	    VertexAttribute attribute = layout.Attribute(location);
+	    // pruned attributes stay disabled, the shader does not read them
+	    if (!layout.Has(location) || attribute.bytes == 0)
+		continue;
+	    glEnableVertexAttribArray(location);
+	    glVertexAttribPointer(location, attribute.size, attribute.type,
+				  attribute.normalized, layout.Stride(),
+				  (void *)layout.Offset(location));
+	}
     }
 
   private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+    std::string glslIdentifierPrefix;
+    DrawPacket packet;
+
+    // keeps the CPU copy of the geometry that retention asks for
+    void retain(const Vertex *vertexData, size_t vertexCount,
+		const unsigned int *indexData, size_t indexCount,
+		GeometryRetention retention)
+    {
+	if (retention == GeometryRetention::Keep)
+	    vertices.assign(vertexData, vertexData + vertexCount);
+	else if (retention == GeometryRetention::Positions)
+	    keepPositions(vertexData, vertexCount);
+	if (retention != GeometryRetention::None)
+	    indices.assign(indexData, indexData + indexCount);
+    }
+
+    void keepPositions(const Vertex *vertexData, size_t vertexCount)
+    {
+	positions.reserve(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	    positions.push_back(vertexData[i].Position);
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount,
+		   const unsigned int *indexData, size_t indexCount)
     {
 	// create buffers/arrays
 	glGenVertexArrays(1, &VAO);
@@ -114,41 +586,44 @@ class Mesh
 	glBindVertexArray(VAO);
 	// load data into vertex buffers
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	// A great thing about structs is that their memory layout is sequential
-	// for all its items. The effect is that we can simply pass a pointer to
-	// the struct and it translates perfectly to a glm::vec3/2 array which
-	// again translates to 3/2 floats which translates to a byte array.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-		     &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.Stride(), nullptr,
+		     GL_STATIC_DRAW);
+	WriteVertices(layout, vertexData, vertexCount, 0);
 
+	// meshes with up to 64K vertices get 16-bit indices, half the index
+	// memory and bandwidth
+	this->indexType = IndexTypeFor(vertexCount);
+	this->indexCount = (unsigned int)indexCount;
+	this->vertexCount = (unsigned int)vertexCount;
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		     indices.size() * sizeof(unsigned int), &indices[0],
+		     indexCount * IndexSize(indexType), nullptr,
 		     GL_STATIC_DRAW);
+	WriteIndices(indexType, indexData, indexCount, 0);
 
-	// set the vertex attribute pointers
-	// vertex Positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			      (void *)0);
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			      (void *)offsetof(Vertex, Normal));
-	// vertex texture coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			      (void *)offsetof(Vertex, TexCoords));
-	// vertex tangent
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			      (void *)offsetof(Vertex, Tangent));
-	// vertex bitangent
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			      (void *)offsetof(Vertex, Bitangent));
+	SetupAttributes(layout);
 
 	glBindVertexArray(0);
     }
+
+    // writes the attributes of layout for one vertex to out
+    static void encodeVertex(const VertexLayout &layout, const Vertex &vertex,
+			     unsigned char *out)
+    {
+	PackedVertex packed;
+	const unsigned char *source = (const unsigned char *)&vertex;
+	if (layout.format == VertexFormat::Packed) {
+	    packed = PackVertex(vertex);
+	    source = (const unsigned char *)&packed;
+	}
+	for (unsigned int location = 0; location < VERTEX_ATTRIBUTE_COUNT;
+	     location++) {
+	    if (!layout.Has(location))
+		continue;
+	    VertexAttribute attribute = layout.Attribute(location);
+	    std::memcpy(out, source + attribute.offset, attribute.bytes);
+	    out += attribute.bytes;
+	}
+    }
 };
 #endif
\ No newline at end of file
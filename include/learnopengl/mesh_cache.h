@@ -0,0 +1,292 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <common.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// On-disk cache of imported meshes, stored next to the source asset as
+// "<asset>.<import flags in hex>.meshcache", so imports with different flags
+// (e.g. with and without tangents, see ModelOptions::attributes) keep
+// separate caches instead of replacing each other's. Layout:
+//   MeshCacheHeader
+//   MeshCacheEntry[meshCount]
+//   per mesh: texture references, vertex blob, index blob (16-byte aligned)
+// Vertex and index blobs are stored exactly as uploaded, so a mapped cache can
+// be handed straight to glBufferData. Meshes are stored after the
+// optimization pass and split for 16-bit indices (see mesh_optimizer.h).
+const uint32_t MESH_CACHE_MAGIC = 0x48534d4c; // "LMSH"
+const uint32_t MESH_CACHE_VERSION = 4;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t importFlags;
+    uint32_t vertexSize;
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshCacheEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t reserved;
+    uint64_t textureOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+};
+
+// a texture reference is stored as two length-prefixed strings
+struct MeshCacheTextureRef {
+    uint32_t typeLength;
+    uint32_t pathLength;
+};
+
+class MeshCache
+{
+  public:
+    // hashes the source asset and the material libraries it names, which
+    // the stored texture references come from; the cache is only valid for
+    // this exact content imported with these flags.
+    MeshCache(const string &sourcePath, unsigned int importFlags)
+	: cachePath(PathFor(sourcePath, importFlags)), importFlags(importFlags)
+    {
+	MappedFile source(sourcePath);
+	if (!source.IsOpen())
+	    return;
+	sourceHash = hashBytes(source.data(), source.size());
+	string directory =
+	    sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+	for (const string &library : materialLibraries(source)) {
+	    // the name too, so a library appearing or going away counts
+	    sourceHash = hashBytes(library.data(), library.size(), sourceHash);
+	    MappedFile materials(directory + library);
+	    if (materials.IsOpen())
+		sourceHash = hashBytes(materials.data(), materials.size(),
+				       sourceHash);
+	}
+    }
+
+    // maps the cache file and validates it against the source asset. Returns
+    // false on a missing, stale or corrupt cache.
+    bool Open()
+    {
+	if (!file.Open(cachePath))
+	    return false;
+	if (file.size() < sizeof(MeshCacheHeader)) {
+	    file.Close();
+	    return false;
+	}
+	const MeshCacheHeader *header =
+	    reinterpret_cast<const MeshCacheHeader *>(file.data());
+	size_t entriesEnd = sizeof(MeshCacheHeader) +
+			    (size_t)header->meshCount * sizeof(MeshCacheEntry);
+	if (header->magic != MESH_CACHE_MAGIC ||
+	    header->version != MESH_CACHE_VERSION ||
+	    header->sourceHash != sourceHash ||
+	    header->importFlags != importFlags ||
+	    header->vertexSize != sizeof(Vertex) || entriesEnd > file.size()) {
+	    file.Close();
+	    return false;
+	}
+	for (unsigned int i = 0; i < header->meshCount; i++) {
+	    const MeshCacheEntry &e = entry(i);
+	    if (e.vertexOffset + (uint64_t)e.vertexCount * sizeof(Vertex) >
+		    file.size() ||
+		e.indexOffset + (uint64_t)e.indexCount * sizeof(unsigned int) >
+		    file.size() ||
+		e.textureOffset > file.size()) {
+		file.Close();
+		return false;
+	    }
+	}
+	return true;
+    }
+
+    unsigned int MeshCount() const
+    {
+	return reinterpret_cast<const MeshCacheHeader *>(file.data())
+	    ->meshCount;
+    }
+    unsigned int VertexCount(unsigned int mesh) const
+    {
+	return entry(mesh).vertexCount;
+    }
+    unsigned int IndexCount(unsigned int mesh) const
+    {
+	return entry(mesh).indexCount;
+    }
+    const Vertex *Vertices(unsigned int mesh) const
+    {
+	return reinterpret_cast<const Vertex *>(file.data() +
+						entry(mesh).vertexOffset);
+    }
+    const unsigned int *Indices(unsigned int mesh) const
+    {
+	return reinterpret_cast<const unsigned int *>(file.data() +
+						      entry(mesh).indexOffset);
+    }
+
+    // texture references of a mesh as (type, path) pairs, ids are left at 0
+    vector<Texture> TextureRefs(unsigned int mesh) const
+    {
+	vector<Texture> textures;
+	const MeshCacheEntry &e = entry(mesh);
+	size_t offset = e.textureOffset;
+	for (unsigned int i = 0; i < e.textureCount; i++) {
+	    if (offset + sizeof(MeshCacheTextureRef) > file.size())
+		break;
+	    MeshCacheTextureRef ref;
+	    std::memcpy(&ref, file.data() + offset, sizeof(ref));
+	    offset += sizeof(ref);
+	    if (offset + ref.typeLength + ref.pathLength > file.size())
+		break;
+	    Texture texture;
+	    texture.id = 0;
+	    texture.type.assign((const char *)file.data() + offset,
+				ref.typeLength);
+	    offset += ref.typeLength;
+	    texture.path.assign((const char *)file.data() + offset,
+				ref.pathLength);
+	    offset += ref.pathLength;
+	    textures.push_back(texture);
+	}
+	return textures;
+    }
+
+    // serializes the imported meshes. The file is written under a temporary
+    // name and renamed so a crashed write never leaves a truncated cache.
+    bool Store(const vector<MeshData> &meshes) const
+    {
+	vector<MeshCacheEntry> entries(meshes.size());
+	uint64_t offset = sizeof(MeshCacheHeader) +
+			  meshes.size() * sizeof(MeshCacheEntry);
+	for (size_t i = 0; i < meshes.size(); i++) {
+	    const MeshData &mesh = meshes[i];
+	    MeshCacheEntry &e = entries[i];
+	    std::memset(&e, 0, sizeof(e));
+	    e.vertexCount = (uint32_t)mesh.vertices.size();
+	    e.indexCount = (uint32_t)mesh.indices.size();
+	    e.textureCount = (uint32_t)mesh.textures.size();
+	    e.textureOffset = offset;
+	    for (const Texture &texture : mesh.textures)
+		offset += sizeof(MeshCacheTextureRef) + texture.type.size() +
+			  texture.path.size();
+	    e.vertexOffset = align(offset);
+	    offset = e.vertexOffset + e.vertexCount * sizeof(Vertex);
+	    e.indexOffset = align(offset);
+	    offset = e.indexOffset + e.indexCount * sizeof(unsigned int);
+	}
+
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.importFlags = importFlags;
+	header.vertexSize = sizeof(Vertex);
+	header.meshCount = (uint32_t)meshes.size();
+
+	string tmpPath = cachePath + ".tmp";
+	std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+	if (!out) {
+	    std::cout << "ERROR::MESH_CACHE:: cannot write " << tmpPath
+		      << std::endl;
+	    return false;
+	}
+	out.write((const char *)&header, sizeof(header));
+	out.write((const char *)entries.data(),
+		  entries.size() * sizeof(MeshCacheEntry));
+	for (size_t i = 0; i < meshes.size(); i++) {
+	    const MeshData &mesh = meshes[i];
+	    for (const Texture &texture : mesh.textures) {
+		MeshCacheTextureRef ref;
+		ref.typeLength = (uint32_t)texture.type.size();
+		ref.pathLength = (uint32_t)texture.path.size();
+		out.write((const char *)&ref, sizeof(ref));
+		out.write(texture.type.data(), ref.typeLength);
+		out.write(texture.path.data(), ref.pathLength);
+	    }
+	    pad(out, entries[i].vertexOffset);
+	    out.write((const char *)mesh.vertices.data(),
+		      mesh.vertices.size() * sizeof(Vertex));
+	    pad(out, entries[i].indexOffset);
+	    out.write((const char *)mesh.indices.data(),
+		      mesh.indices.size() * sizeof(unsigned int));
+	}
+	out.close();
+	if (!out || std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+	    std::remove(tmpPath.c_str());
+	    return false;
+	}
+	return true;
+    }
+
+    const string &Path() const { return cachePath; }
+
+    // where the cache of sourcePath imported with importFlags is stored
+    static string PathFor(const string &sourcePath, unsigned int importFlags)
+    {
+	char flags[16];
+	std::snprintf(flags, sizeof(flags), ".%x", importFlags);
+	return sourcePath + flags + ".meshcache";
+    }
+
+  private:
+    string cachePath;
+    unsigned int importFlags;
+    uint64_t sourceHash = 0;
+    MappedFile file;
+
+    const MeshCacheEntry &entry(unsigned int mesh) const
+    {
+	return reinterpret_cast<const MeshCacheEntry *>(
+	    file.data() + sizeof(MeshCacheHeader))[mesh];
+    }
+
+    // the files named on the "mtllib" lines of an OBJ, relative to it
+    static vector<string> materialLibraries(const MappedFile &source)
+    {
+	vector<string> libraries;
+	const char *data = (const char *)source.data();
+	size_t size = source.size();
+	for (size_t line = 0; line < size;) {
+	    size_t end = line;
+	    while (end < size && data[end] != '\n')
+		end++;
+	    if (end - line > 7 && std::memcmp(data + line, "mtllib", 6) == 0 &&
+		(data[line + 6] == ' ' || data[line + 6] == '\t')) {
+		std::istringstream names(
+		    string(data + line + 7, end - line - 7));
+		string name;
+		while (names >> name)
+		    libraries.push_back(name);
+	    }
+	    line = end + 1;
+	}
+	return libraries;
+    }
+
+    static uint64_t align(uint64_t offset) { return (offset + 15) & ~15ull; }
+
+    static void pad(std::ofstream &out, uint64_t offset)
+    {
+	static const char zeros[16] = {};
+	uint64_t position = (uint64_t)out.tellp();
+	if (offset > position)
+	    out.write(zeros, offset - position);
+    }
+};
+
+#endif
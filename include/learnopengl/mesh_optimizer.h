@@ -0,0 +1,341 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <common.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Import-time mesh optimization: welds duplicate vertices, reorders triangles
+// for post-transform vertex cache reuse (Forsyth's linear-speed algorithm) and
+// reorders vertices into first-use order for vertex fetch locality. All
+// functions are CPU only and expect triangle lists.
+
+// FIFO cache size used to estimate post-transform cache efficiency, a common
+// approximation of the hardware cache
+const unsigned int VERTEX_CACHE_SIZE_FIFO = 16;
+// LRU cache size the triangle order is optimized for
+const unsigned int VERTEX_CACHE_SIZE_LRU = 32;
+
+// ACMR: transformed vertices per triangle, 0.5 is ideal for large regular
+// grids, 3 means no reuse at all. ATVR: transformed vertices per unique
+// vertex, 1 is ideal.
+struct VertexCacheStats {
+    size_t triangles = 0;
+    size_t vertices = 0;
+    size_t transformed = 0;
+
+    float ACMR() const
+    {
+	return triangles ? (float)transformed / triangles : 0.0f;
+    }
+    float ATVR() const
+    {
+	return vertices ? (float)transformed / vertices : 0.0f;
+    }
+
+    VertexCacheStats &operator+=(const VertexCacheStats &other)
+    {
+	triangles += other.triangles;
+	vertices += other.vertices;
+	transformed += other.transformed;
+	return *this;
+    }
+};
+
+// what OptimizeMesh did to one or more meshes
+struct MeshOptimizerStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    VertexCacheStats before;
+    VertexCacheStats after;
+
+    MeshOptimizerStats &operator+=(const MeshOptimizerStats &other)
+    {
+	verticesBefore += other.verticesBefore;
+	verticesAfter += other.verticesAfter;
+	before += other.before;
+	after += other.after;
+	return *this;
+    }
+
+    void Report(std::ostream &out) const
+    {
+	out << "Mesh optimizer: " << verticesBefore << " -> " << verticesAfter
+	    << " vertices, ACMR " << before.ACMR() << " -> " << after.ACMR()
+	    << ", ATVR " << before.ATVR() << " -> " << after.ATVR() << " ("
+	    << before.transformed << " -> " << after.transformed
+	    << " vertex shader invocations)" << std::endl;
+    }
+};
+
+// simulates a FIFO post-transform cache over a triangle list
+inline VertexCacheStats
+AnalyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount,
+		   unsigned int cacheSize = VERTEX_CACHE_SIZE_FIFO)
+{
+    VertexCacheStats stats;
+    stats.triangles = indices.size() / 3;
+    stats.vertices = vertexCount;
+    // a vertex is cached while fewer than cacheSize misses happened since it
+    // was last transformed
+    vector<size_t> insertedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (unsigned int index : indices) {
+	if (insertedAt[index] == 0 || misses - insertedAt[index] >= cacheSize) {
+	    misses++;
+	    insertedAt[index] = misses;
+	}
+    }
+    stats.transformed = misses;
+    return stats;
+}
+
+// merges vertices whose attributes are bitwise identical and rewrites the
+// indices to the merged vertices
+inline void WeldVertices(vector<Vertex> &vertices,
+			 vector<unsigned int> &indices)
+{
+    struct VertexHash {
+	size_t operator()(const Vertex &v) const
+	{
+	    return (size_t)hashBytes(&v, sizeof(Vertex));
+	}
+    };
+    struct VertexEqual {
+	bool operator()(const Vertex &a, const Vertex &b) const
+	{
+	    return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+    };
+    unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+	auto inserted =
+	    unique.emplace(vertices[i], (unsigned int)welded.size());
+	if (inserted.second)
+	    welded.push_back(vertices[i]);
+	remap[i] = inserted.first->second;
+    }
+    for (unsigned int &index : indices)
+	index = remap[index];
+    vertices.swap(welded);
+}
+
+namespace forsyth
+{
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+inline float vertexScore(int cachePosition, unsigned int remaining)
+{
+    if (remaining == 0)
+	return -1.0f; // no triangle needs this vertex anymore
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+	if (cachePosition < 3) {
+	    // used by the last triangle, a fixed score discourages emitting
+	    // strips of triangles that share an edge with the previous one
+	    score = LAST_TRIANGLE_SCORE;
+	} else {
+	    float scale = 1.0f / (VERTEX_CACHE_SIZE_LRU - 3);
+	    score = std::pow(1.0f - (cachePosition - 3) * scale,
+			     CACHE_DECAY_POWER);
+	}
+    }
+    // favour vertices with few triangles left, so they can leave the cache
+    return score + VALENCE_BOOST_SCALE *
+		       std::pow((float)remaining, -VALENCE_BOOST_POWER);
+}
+} // namespace forsyth
+
+// reorders the triangles of an indexed triangle list for post-transform
+// vertex cache reuse, see Tom Forsyth, "Linear-Speed Vertex Cache
+// Optimisation"
+inline void OptimizeVertexCache(vector<unsigned int> &indices,
+				size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+	return;
+
+    // vertex -> triangle adjacency in one flat array
+    vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+	remaining[index]++;
+    vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+	adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+	adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+	vertexScore[v] = forsyth::vertexScore(-1, remaining[v]);
+    vector<bool> emitted(triangleCount, false);
+
+    vector<unsigned int> cache, nextCache;
+    cache.reserve(VERTEX_CACHE_SIZE_LRU + 3);
+    nextCache.reserve(VERTEX_CACHE_SIZE_LRU + 3);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    size_t scan = 0; // first triangle that may not be emitted yet
+    long best = -1;
+
+    while (result.size() < indices.size()) {
+	if (best < 0) {
+	    // nothing in the cache is useful, continue with the next triangle
+	    // in input order
+	    while (emitted[scan])
+		scan++;
+	    best = (long)scan;
+	}
+	const unsigned int *triangle = &indices[best * 3];
+	emitted[best] = true;
+	result.insert(result.end(), triangle, triangle + 3);
+
+	// drop the triangle from the adjacency of its vertices
+	for (int k = 0; k < 3; k++) {
+	    unsigned int v = triangle[k];
+	    unsigned int *list = &adjacency[adjacencyStart[v]];
+	    for (unsigned int i = 0; i < remaining[v]; i++) {
+		if (list[i] == (unsigned int)best) {
+		    list[i] = list[remaining[v] - 1];
+		    break;
+		}
+	    }
+	    remaining[v]--;
+	}
+
+	// move the triangle's vertices to the front of the LRU cache
+	nextCache.assign(triangle, triangle + 3);
+	for (unsigned int v : cache)
+	    if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+		nextCache.push_back(v);
+	cache.swap(nextCache);
+	for (size_t i = 0; i < cache.size(); i++) {
+	    unsigned int v = cache[i];
+	    cachePosition[v] = i < VERTEX_CACHE_SIZE_LRU ? (int)i : -1;
+	    vertexScore[v] =
+		forsyth::vertexScore(cachePosition[v], remaining[v]);
+	}
+
+	// rescore the triangles touching the cache and pick the best one
+	best = -1;
+	float bestScore = -1.0f;
+	for (unsigned int v : cache) {
+	    for (unsigned int i = 0; i < remaining[v]; i++) {
+		unsigned int t = adjacency[adjacencyStart[v] + i];
+		float score = vertexScore[indices[t * 3]] +
+			      vertexScore[indices[t * 3 + 1]] +
+			      vertexScore[indices[t * 3 + 2]];
+		if (score > bestScore) {
+		    bestScore = score;
+		    best = (long)t;
+		}
+	    }
+	}
+	if (cache.size() > VERTEX_CACHE_SIZE_LRU)
+	    cache.resize(VERTEX_CACHE_SIZE_LRU);
+    }
+    indices.swap(result);
+}
+
+// renumbers vertices in the order the indices first reference them, so the
+// vertex fetch walks the buffer mostly sequentially. Unreferenced vertices are
+// dropped.
+inline void OptimizeVertexFetch(vector<Vertex> &vertices,
+				vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int &index : indices) {
+	if (remap[index] == unused) {
+	    remap[index] = (unsigned int)ordered.size();
+	    ordered.push_back(vertices[index]);
+	}
+	index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+// splits a triangle list into parts of at most maxVertices vertices each, so
+// every part can be drawn with 16-bit indices. Triangles keep their order, so
+// a cache and fetch optimized mesh stays optimized and splits into few parts.
+inline vector<MeshData> SplitMesh(MeshData &&mesh,
+				  size_t maxVertices = SHORT_INDEX_VERTEX_LIMIT)
+{
+    vector<MeshData> parts;
+    if (mesh.vertices.size() <= maxVertices || mesh.indices.size() % 3 != 0) {
+	parts.push_back(std::move(mesh));
+	return parts;
+    }
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(mesh.vertices.size(), unused);
+    vector<unsigned int> used; // source vertices of the current part
+    MeshData part;
+    for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+	const unsigned int *triangle = &mesh.indices[t];
+	size_t added = 0;
+	for (int k = 0; k < 3; k++)
+	    if (remap[triangle[k]] == unused)
+		added++;
+	if (part.vertices.size() + added > maxVertices) {
+	    // the part is full, forget its vertices and start the next one
+	    for (unsigned int v : used)
+		remap[v] = unused;
+	    used.clear();
+	    part.textures = mesh.textures;
+	    part.bounds = BoundsOf(part.vertices.data(), part.vertices.size());
+	    parts.push_back(std::move(part));
+	    part = MeshData();
+	}
+	for (int k = 0; k < 3; k++) {
+	    unsigned int v = triangle[k];
+	    if (remap[v] == unused) {
+		remap[v] = (unsigned int)part.vertices.size();
+		part.vertices.push_back(mesh.vertices[v]);
+		used.push_back(v);
+	    }
+	    part.indices.push_back(remap[v]);
+	}
+    }
+    part.textures = std::move(mesh.textures);
+    part.bounds = BoundsOf(part.vertices.data(), part.vertices.size());
+    parts.push_back(std::move(part));
+    return parts;
+}
+
+// runs the whole pipeline on an imported triangle list
+inline MeshOptimizerStats OptimizeMesh(MeshData &mesh)
+{
+    MeshOptimizerStats stats;
+    stats.verticesBefore = mesh.vertices.size();
+    stats.before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    if (mesh.indices.size() % 3 == 0) {
+	WeldVertices(mesh.vertices, mesh.indices);
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeVertexFetch(mesh.vertices, mesh.indices);
+    }
+    stats.verticesAfter = mesh.vertices.size();
+    stats.after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+    return stats;
+}
+
+#endif
@@ -10,20 +10,81 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
 
+#include <learnopengl/dds.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mapped_file.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/parallel.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/startup_timeline.h>
+#include <learnopengl/texture_registry.h>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
+// CPU side of a texture load, produced by DecodeImage on any thread and
+// consumed by UploadTexture on the thread that owns the GL context. Holds
+// either stb decoded pixels or a pre-compressed DDS mip chain.
+struct ImageData {
+    unsigned char *pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    uint64_t contentHash = 0; // hash of the encoded file, 0 if not computed
+    DDSImage compressed;
+
+    // video memory the texture will take, mip chain included
+    size_t GPUBytes() const
+    {
+	if (compressed.IsValid())
+	    return compressed.Bytes();
+	return (size_t)width * height * components * 4 / 3;
+    }
+};
+
+ImageData DecodeImage(const string &filename, bool hashContent = false);
+unsigned int UploadTexture(const ImageData &image);
 unsigned int TextureFromFile(const char *path, const string &directory,
 			     bool gamma = false);
 
+// GPU buffers of a model's meshes
+enum class MeshStorage {
+    Separate, // a VAO, vertex and index buffer per mesh
+    Shared    // one VAO, vertex and index buffer for the whole model
+};
+
+// how a model is imported and laid out on the GPU
+struct ModelOptions {
+    VertexFormat vertexFormat = VertexFormat::Float;
+    MeshStorage storage = MeshStorage::Separate;
+    // CPU geometry the meshes keep once uploaded
+    GeometryRetention geometry = GeometryRetention::Keep;
+    // vertex attributes the shaders drawing the model read, as a location
+    // mask (see Shader::ActiveAttributes). The others are not uploaded, and
+    // without tangent or bitangent readers tangents are not generated.
+    unsigned int attributes = VERTEX_ALL_ATTRIBUTES;
+
+    VertexLayout Layout() const
+    {
+	return VertexLayout(vertexFormat, attributes);
+    }
+};
+
 class Model
 {
   public:
@@ -32,39 +93,261 @@ class Model
 	textures_loaded; // stores all the textures loaded so far, optimization
 			 // to make sure textures aren't loaded more than once.
     vector<Mesh> meshes;
+    // union of the meshes' bounds, in model space; set once imported
+    Bounds bounds;
     string directory;
     bool gammaCorrection;
+    ModelOptions options;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. Blocks until the model
+    // is imported and uploaded, see AsyncModel for loading in the background.
+    Model(string const &path, bool gamma = false,
+	  ModelOptions options = ModelOptions())
+	: gammaCorrection(gamma), options(options)
     {
-	loadModel(path);
+	importModel(path);
+	uploadPending(pendingMeshes.size());
+    }
+
+    // a model owns GL objects, so it is shared (see ModelCache) rather than
+    // copied
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    ~Model()
+    {
+	for (Mesh &mesh : meshes)
+	    mesh.Release();
+	glDeleteVertexArrays(1, &sharedVAO);
+	glDeleteBuffers(1, &sharedVBO);
+	glDeleteBuffers(1, &sharedEBO);
+	glDeleteBuffers(1, &instanceVBO);
+	for (Texture &texture : textures_loaded)
+	    TextureRegistry::Instance().Release(texture.id);
+	for (ImageData &image : images)
+	    stbi_image_free(image.pixels);
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+	// with shared storage the VAO is bound once for all meshes
+	if (sharedVAO)
+	    GLState::Instance().BindVertexArray(sharedVAO);
 	for (unsigned int i = 0; i < meshes.size(); i++)
 	    meshes[i].Draw(shader);
     }
 
+    // resolves the draw packets of all meshes against shader up front, Draw
+    // would otherwise do it on first use. Leaves shader in use.
+    void Bake(Shader &shader)
+    {
+	for (Mesh &mesh : meshes)
+	    mesh.Bake(shader);
+    }
+
+    // draws every instance of the model with one instanced draw per mesh,
+    // however many instances there are. The transforms are uploaded to an
+    // instance buffer on each call; shader's "instanced" uniform selects
+    // the instance attributes over the "model" uniform.
+    void DrawInstanced(Shader &shader, const vector<InstanceData> &instances)
+    {
+	if (instances.empty())
+	    return;
+	uploadInstances(instances);
+	if (placementShader != &shader) {
+	    placement = PlacementUniforms(shader);
+	    placementShader = &shader;
+	}
+	placement.instanced.Set(true);
+	placement.batched.Set(false);
+	// keeps the samplerBuffer off the texture units of the meshes
+	placement.transforms.Set(TRANSFORM_BUFFER_UNIT);
+	if (sharedVAO)
+	    GLState::Instance().BindVertexArray(sharedVAO);
+	for (Mesh &mesh : meshes)
+	    mesh.DrawInstanced(shader, (GLsizei)instances.size());
+	placement.instanced.Set(false);
+    }
+
+    // queues one command per mesh that draws all instances, like
+    // DrawInstanced. The instances are uploaded now, so a model takes one
+    // Submit per frame. The depth key is the nearest instance's origin.
+    // Instances outside the queue's frustum are left out, and meshes
+    // outside it in every remaining instance are not queued.
+    void Submit(RenderQueue &queue, Shader &shader,
+		const PipelineState &pipeline,
+		const vector<InstanceData> &instances)
+    {
+	visibleInstances.clear();
+	for (const InstanceData &instance : instances)
+	    if (queue.ModelInView(placeBounds(bounds, instance)))
+		visibleInstances.push_back(instance);
+	if (visibleInstances.empty())
+	    return;
+	uploadInstances(visibleInstances);
+	RenderCommand command;
+	command.pipeline = &pipeline;
+	command.shader = &shader;
+	command.vao = sharedVAO;
+	command.instanceCount = (GLsizei)visibleInstances.size();
+	command.depth =
+	    queue.Distance(glm::vec3(visibleInstances[0].transform[3]));
+	for (const InstanceData &instance : visibleInstances) {
+	    glm::vec3 origin = glm::vec3(instance.transform[3]);
+	    command.depth = std::min(command.depth, queue.Distance(origin));
+	}
+	for (Mesh &mesh : meshes) {
+	    bool visible = false;
+	    for (const InstanceData &instance : visibleInstances)
+		visible |=
+		    queue.MeshInView(placeBounds(mesh.bounds, instance));
+	    if (!visible)
+		continue;
+	    command.mesh = &mesh;
+	    queue.Submit(command);
+	}
+    }
+
+    // queues every mesh once per instance, placed through the queue's
+    // transform buffer instead of instance attributes. With shared storage
+    // the meshes of an instance that share textures become one multi-draw,
+    // so the draw count follows the materials, not the meshes. Instances
+    // and meshes outside the queue's frustum are skipped.
+    void SubmitBatched(RenderQueue &queue, Shader &shader,
+		       const PipelineState &pipeline,
+		       const vector<InstanceData> &instances)
+    {
+	RenderCommand command;
+	command.pipeline = &pipeline;
+	command.shader = &shader;
+	command.vao = sharedVAO;
+	for (const InstanceData &instance : instances) {
+	    if (!queue.ModelInView(placeBounds(bounds, instance)))
+		continue;
+	    command.transformIndex = queue.AddTransform(instance);
+	    command.depth = queue.Distance(glm::vec3(instance.transform[3]));
+	    for (Mesh &mesh : meshes) {
+		if (!queue.MeshInView(placeBounds(mesh.bounds, instance)))
+		    continue;
+		command.mesh = &mesh;
+		queue.Submit(command);
+	    }
+	}
+    }
+
+    // the ASSIMP post-processing a model loaded with options gets, which
+    // also names its mesh cache (see MeshCache::PathFor)
+    static unsigned int ImportFlags(const ModelOptions &options)
+    {
+	unsigned int importFlags = aiProcess_Triangulate |
+				   aiProcess_GenSmoothNormals |
+				   aiProcess_FlipUVs;
+	// tangent generation is one of the costlier post-processing steps,
+	// only run it for shaders that read tangents
+	if (options.attributes & (VERTEX_TANGENT | VERTEX_BITANGENT))
+	    importFlags |= aiProcess_CalcTangentSpace;
+	return importFlags;
+    }
+
+    // whether any mesh has a texture of type, e.g. "texture_specular"
+    bool HasTextureType(const string &type) const
+    {
+	for (const Texture &texture : textures_loaded)
+	    if (texture.type == type)
+		return true;
+	return false;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix)
     {
 	for (Mesh &mesh : meshes) {
-	    mesh.glslIdentifierPrefix = prefix;
+	    mesh.SetShaderTextureNamePrefix(prefix);
 	}
     }
 
+    // vertex and index buffer footprint of the model, compared with the
+    // full float layout and 32-bit indices
+    void ReportVertexFormat(std::ostream &out) const
+    {
+	size_t vertices = 0, indices = 0, indexBytes = 0, shortMeshes = 0;
+	for (const Mesh &mesh : meshes) {
+	    vertices += mesh.vertexCount;
+	    indices += mesh.indexCount;
+	    indexBytes += mesh.indexCount * IndexSize(mesh.indexType);
+	    if (mesh.indexType == GL_UNSIGNED_SHORT)
+		shortMeshes++;
+	}
+	size_t stride = options.Layout().Stride();
+	size_t floatStride = sizeof(Vertex);
+	// without post-transform cache hits every index fetches one vertex,
+	// which bounds the vertex fetch traffic of a single draw
+	out << "Vertex format: " << vertices << " vertices, " << stride
+	    << " bytes per vertex (float layout " << floatStride << "), "
+	    << vertices * stride / 1024 << " KiB buffers, "
+	    << vertices * (floatStride - stride) / 1024 << " KiB saved, "
+	    << indices * (floatStride - stride) / 1024
+	    << " KiB less vertex fetch per draw" << endl;
+	out << "Index format: " << shortMeshes << " of " << meshes.size()
+	    << " meshes 16-bit, " << indexBytes / 1024 << " KiB index buffers, "
+	    << (indices * sizeof(unsigned int) - indexBytes) / 1024
+	    << " KiB saved" << endl;
+    }
+
   private:
-    // loads a model with supported ASSIMP extensions from file and stores the
-    // resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    friend class AsyncModel;
+
+    // index into textures_loaded by texture path
+    unordered_map<string, size_t> textureIndex;
+    // import results waiting for the GL thread
+    vector<MeshData> pendingMeshes;
+    vector<string> textureKeys;
+    vector<ImageData> images;
+    bool texturesUploaded = false;
+    // set when the meshes come from a mesh cache, mapped until uploaded
+    unique_ptr<MeshCache> meshCache;
+    // effect of the optimization pass over all meshes of a fresh import
+    MeshOptimizerStats optimizerStats;
+    // buffers of MeshStorage::Shared, and the next free range in them
+    unsigned int sharedVAO = 0, sharedVBO = 0, sharedEBO = 0;
+    SharedMeshRange nextRange;
+    // per-instance data of DrawInstanced, attached to every VAO
+    unsigned int instanceVBO = 0;
+    // placement uniforms of the shader DrawInstanced last drew with
+    Shader *placementShader = nullptr;
+    PlacementUniforms placement;
+    // the instances Submit found in view, kept to reuse its storage
+    vector<InstanceData> visibleInstances;
+
+    // an empty model for AsyncModel to import into
+    Model(bool gamma, ModelOptions options)
+	: gammaCorrection(gamma), options(options)
     {
+    }
+
+    // CPU half of loading a model with supported ASSIMP extensions: parses
+    // the file (or its mesh cache) into pendingMeshes and decodes the
+    // textures. Makes no GL calls, so it may run on a loader thread.
+    void importModel(string const &path)
+    {
+	unsigned int importFlags = ImportFlags(options);
+	// retrieve the directory path of the filepath
+	directory = path.substr(0, path.find_last_of('/'));
+	StartupTimeline::Scope timing("import " + path);
+
+	// a valid mesh cache next to the asset skips ASSIMP entirely
+	unique_ptr<MeshCache> cache(new MeshCache(path, importFlags));
+	if (cache->Open()) {
+	    loadFromCache(*cache);
+	    meshCache = std::move(cache);
+	    gatherBounds();
+	    decodeTextures();
+	    return;
+	}
+
 	// read file via ASSIMP
 	Assimp::Importer importer;
-	const aiScene *scene = importer.ReadFile(
-	    path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-		      aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	const aiScene *scene = importer.ReadFile(path, importFlags);
 	// check for errors
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
 	    !scene->mRootNode) // if is Not Zero
@@ -72,11 +355,184 @@ class Model
 	    cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
 	    return;
 	}
-	// retrieve the directory path of the filepath
-	directory = path.substr(0, path.find_last_of('/'));
 
 	// process ASSIMP's root node recursively
 	processNode(scene->mRootNode, scene);
+	optimizerStats.Report(cout);
+	gatherBounds();
+	decodeTextures();
+
+	if (!cache->Store(pendingMeshes))
+	    cout << "WARNING::MESH_CACHE:: failed to write " << cache->Path()
+		 << endl;
+    }
+
+    // GL half of loading: uploads the decoded textures, then up to maxMeshes
+    // of the pending meshes. Returns true once everything is uploaded.
+    bool uploadPending(size_t maxMeshes)
+    {
+	if (!texturesUploaded) {
+	    uploadTextures();
+	    texturesUploaded = true;
+	    // uploads bind textures behind the state cache
+	    GLState::Instance().Invalidate();
+	}
+	if (pendingMeshes.empty())
+	    return true;
+	if (options.storage == MeshStorage::Shared && !sharedVAO)
+	    createSharedBuffers();
+	meshes.reserve(pendingMeshes.size());
+	// clamped by what is left, maxMeshes may be SIZE_MAX (AsyncModel)
+	size_t end = meshes.size() +
+		     std::min(maxMeshes, pendingMeshes.size() - meshes.size());
+	for (size_t i = meshes.size(); i < end; i++) {
+	    meshes.push_back(createMesh(i));
+	    meshes.back().bounds = pendingMeshes[i].bounds;
+	}
+	// so does creating the mesh buffers
+	GLState::Instance().Invalidate();
+	if (meshes.size() < pendingMeshes.size())
+	    return false;
+	pendingMeshes.clear();
+	pendingMeshes.shrink_to_fit();
+	meshCache.reset();
+	return true;
+    }
+
+    // collects the texture references of a mapped cache; the geometry stays
+    // in the mapping and is uploaded from there.
+    void loadFromCache(const MeshCache &cache)
+    {
+	pendingMeshes.resize(cache.MeshCount());
+	for (unsigned int i = 0; i < cache.MeshCount(); i++) {
+	    vector<Texture> textures = cache.TextureRefs(i);
+	    for (Texture &texture : textures)
+		texture = loadTexture(texture.path, texture.type);
+	    pendingMeshes[i].textures = std::move(textures);
+	    // not stored in the cache, a pass over the mapped positions
+	    pendingMeshes[i].bounds =
+		BoundsOf(cache.Vertices(i), cache.VertexCount(i));
+	}
+    }
+
+    // the model's bounds from those of its pending meshes
+    void gatherBounds()
+    {
+	bounds = Bounds();
+	for (const MeshData &data : pendingMeshes)
+	    bounds.Extend(data.bounds);
+    }
+
+    // bounds of geometry placed by instance, grown by the vertical bob the
+    // shader adds on top of the transform
+    static Bounds placeBounds(const Bounds &local, const InstanceData &instance)
+    {
+	Bounds placed = local.Transformed(instance.transform);
+	if (placed.IsEmpty())
+	    return placed;
+	float bob = std::abs(instance.bobAmplitude);
+	placed.box.min.y -= bob;
+	placed.box.max.y += bob;
+	placed.sphere.radius += bob;
+	return placed;
+    }
+
+    Mesh createMesh(size_t i)
+    {
+	MeshData &data = pendingMeshes[i];
+	for (Texture &texture : data.textures)
+	    texture.id = textures_loaded[textureIndex[texture.path]].id;
+	if (sharedVAO)
+	    return createSharedMesh(i);
+	if (meshCache)
+	    return Mesh(meshCache->Vertices(i), meshCache->VertexCount(i),
+			meshCache->Indices(i), meshCache->IndexCount(i),
+			std::move(data.textures), options.Layout(),
+			options.geometry);
+	return Mesh(std::move(data.vertices), std::move(data.indices),
+		    std::move(data.textures), options.Layout(),
+		    options.geometry);
+    }
+
+    // creates the instance buffer and attaches it to the VAOs on first use,
+    // then streams instances into it
+    void uploadInstances(const vector<InstanceData> &instances)
+    {
+	GLState &state = GLState::Instance();
+	if (!instanceVBO) {
+	    glGenBuffers(1, &instanceVBO);
+	    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	    if (sharedVAO) {
+		state.BindVertexArray(sharedVAO);
+		SetupVertexAttributes<InstanceData>(0, 1);
+	    } else {
+		for (Mesh &mesh : meshes) {
+		    state.BindVertexArray(mesh.VAO);
+		    SetupVertexAttributes<InstanceData>(0, 1);
+		}
+	    }
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData),
+		     instances.data(), GL_STREAM_DRAW);
+    }
+
+    // sizes the shared buffers for all pending meshes. The index type is the
+    // smallest one every mesh fits, base vertices keep indices mesh-relative.
+    void createSharedBuffers()
+    {
+	size_t vertexCount = 0, indexCount = 0, largestMesh = 0;
+	for (size_t i = 0; i < pendingMeshes.size(); i++) {
+	    size_t vertices = meshCache ? meshCache->VertexCount(i)
+					: pendingMeshes[i].vertices.size();
+	    vertexCount += vertices;
+	    indexCount += meshCache ? meshCache->IndexCount(i)
+				    : pendingMeshes[i].indices.size();
+	    largestMesh = std::max(largestMesh, vertices);
+	}
+	nextRange = SharedMeshRange();
+	nextRange.indexType = IndexTypeFor(largestMesh);
+
+	glGenVertexArrays(1, &sharedVAO);
+	glGenBuffers(1, &sharedVBO);
+	glGenBuffers(1, &sharedEBO);
+	glBindVertexArray(sharedVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, sharedVBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * options.Layout().Stride(),
+		     nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		     indexCount * IndexSize(nextRange.indexType), nullptr,
+		     GL_STATIC_DRAW);
+	Mesh::SetupAttributes(options.Layout());
+	glBindVertexArray(0);
+    }
+
+    // writes pending mesh i into the shared buffers after the previous one
+    Mesh createSharedMesh(size_t i)
+    {
+	MeshData &data = pendingMeshes[i];
+	const Vertex *vertices = data.vertices.data();
+	const unsigned int *indices = data.indices.data();
+	size_t vertexCount = data.vertices.size();
+	size_t indexCount = data.indices.size();
+	if (meshCache) {
+	    vertices = meshCache->Vertices(i);
+	    indices = meshCache->Indices(i);
+	    vertexCount = meshCache->VertexCount(i);
+	    indexCount = meshCache->IndexCount(i);
+	}
+	glBindVertexArray(sharedVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, sharedVBO);
+	Mesh mesh(vertices, vertexCount, indices, indexCount,
+		  std::move(data.textures), nextRange, options.Layout(),
+		  options.geometry);
+	glBindVertexArray(0);
+	nextRange.baseVertex += (GLint)vertexCount;
+	nextRange.firstIndex += indexCount;
+	vector<Vertex>().swap(data.vertices);
+	vector<unsigned int>().swap(data.indices);
+	return mesh;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh
@@ -90,7 +546,9 @@ class Model
 	    // in the scene. the scene contains all the data, node is just to
 	    // keep stuff organized (like relations between nodes).
 	    aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-	    meshes.push_back(processMesh(mesh, scene));
+	    // meshes too large for 16-bit indices are split into parts
+	    for (MeshData &part : SplitMesh(processMesh(mesh, scene)))
+		pendingMeshes.push_back(std::move(part));
 	}
 	// after we've processed all of the meshes (if any) we then recursively
 	// process each of the children nodes
@@ -99,12 +557,14 @@ class Model
 	}
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
 	// data to fill
 	vector<Vertex> vertices;
 	vector<unsigned int> indices;
 	vector<Texture> textures;
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(mesh->mNumFaces * 3);
 
 	// walk through each of the mesh's vertices
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -137,6 +597,11 @@ class Model
 		vec.x = mesh->mTextureCoords[0][i].x;
 		vec.y = mesh->mTextureCoords[0][i].y;
 		vertex.TexCoords = vec;
+	    } else
+		vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+	    // tangent space, only imported when a shader reads it
+	    vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
+	    if (mesh->HasTangentsAndBitangents()) {
 		// tangent
 		vector.x = mesh->mTangents[i].x;
 		vector.y = mesh->mTangents[i].y;
@@ -147,8 +612,7 @@ class Model
 		vector.y = mesh->mBitangents[i].y;
 		vector.z = mesh->mBitangents[i].z;
 		vertex.Bitangent = vector;
-	    } else
-		vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+	    }
 
 	    vertices.push_back(vertex);
 	}
@@ -190,8 +654,15 @@ class Model
 	    material, aiTextureType_AMBIENT, "texture_height");
 	textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-	// return a mesh object created from the extracted mesh data
-	return Mesh(vertices, indices, textures);
+	// return the extracted mesh data, the GL thread turns it into a Mesh
+	MeshData data;
+	data.vertices = std::move(vertices);
+	data.indices = std::move(indices);
+	data.textures = std::move(textures);
+	// ASSIMP emits one vertex per face corner, weld and reorder them
+	optimizerStats += OptimizeMesh(data);
+	data.bounds = BoundsOf(data.vertices.data(), data.vertices.size());
+	return data;
     }
 
     // checks all material textures of a given type and loads the textures if
@@ -204,59 +675,194 @@ class Model
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 	    aiString str;
 	    mat->GetTexture(type, i, &str);
-	    // check if texture was loaded before and if so, continue to next
-	    // iteration: skip loading a new texture
-	    bool skip = false;
-	    for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-		if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) ==
-		    0) {
-		    textures.push_back(textures_loaded[j]);
-		    skip = true; // a texture with the same filepath has already
-				 // been loaded, continue to next one.
-				 // (optimization)
-		    break;
-		}
-	    }
-	    if (!skip) { // if texture hasn't been loaded already, load it
-		Texture texture;
-		texture.id = TextureFromFile(str.C_Str(), this->directory);
-		texture.type = typeName;
-		texture.path = str.C_Str();
-		textures.push_back(texture);
-		textures_loaded.push_back(
-		    texture); // store it as texture loaded for entire model, to
-			      // ensure we won't unnecesery load duplicate
-			      // textures.
-	    }
+	    textures.push_back(loadTexture(str.C_Str(), typeName));
 	}
 	return textures;
     }
+
+    // returns the texture at path (relative to the model directory). New
+    // textures are only registered here, with id 0; loadTextures() loads all
+    // of them once the meshes are processed.
+    Texture loadTexture(const string &path, const string &typeName)
+    {
+	// check if texture was loaded before and if so, skip loading a new
+	// texture
+	auto it = textureIndex.find(path);
+	if (it != textureIndex.end())
+	    return textures_loaded[it->second];
+	// if texture hasn't been loaded already, queue it
+	Texture texture;
+	texture.id = 0;
+	texture.type = typeName;
+	texture.path = path;
+	textureIndex[path] = textures_loaded.size();
+	textures_loaded.push_back(
+	    texture); // store it as texture loaded for entire model, to
+		      // ensure we won't unnecesery load duplicate
+		      // textures.
+	return texture;
+    }
+
+    // resolves every queued texture through the process-wide registry and
+    // decodes the misses in parallel. No GL calls.
+    void decodeTextures()
+    {
+	StartupTimeline::Scope timing("decode textures of " + directory);
+	TextureRegistry &registry = TextureRegistry::Instance();
+	textureKeys.resize(textures_loaded.size());
+	for (size_t i = 0; i < textures_loaded.size(); i++) {
+	    Texture &texture = textures_loaded[i];
+	    textureKeys[i] = canonicalPath(directory + '/' + texture.path);
+	    texture.id = registry.Acquire(textureKeys[i]);
+	}
+
+	images.resize(textures_loaded.size());
+	bool hashContent = registry.ContentDedupe();
+	ParallelFor(textures_loaded.size(), [&](size_t i) {
+	    if (textures_loaded[i].id == 0)
+		images[i] = DecodeImage(textureKeys[i], hashContent);
+	});
+    }
+
+    // uploads the decoded misses on this (the GL) thread, reusing textures
+    // that became resident by path or content in the meantime.
+    void uploadTextures()
+    {
+	TextureRegistry &registry = TextureRegistry::Instance();
+	for (size_t i = 0; i < textures_loaded.size(); i++) {
+	    Texture &texture = textures_loaded[i];
+	    if (texture.id != 0)
+		continue;
+	    ImageData &image = images[i];
+	    texture.id =
+		registry.AcquireContent(textureKeys[i], image.contentHash);
+	    if (texture.id == 0) {
+		texture.id = UploadTexture(image);
+		registry.Add(textureKeys[i], texture.id, image.contentHash,
+			     image.GPUBytes());
+	    }
+	    stbi_image_free(image.pixels);
+	    image.pixels = nullptr;
+	}
+	images.clear();
+	textureKeys.clear();
+    }
 };
 
-unsigned int TextureFromFile(const char *path, const string &directory,
-			     bool gamma)
+// whether the driver can sample a DDS payload directly
+inline bool CompressedFormatSupported(GLenum format)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    switch (format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	return GLExtensions::S3TC();
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	return GLExtensions::BPTC();
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+	return true; // core since 3.0
+    }
+    return false;
+}
+
+// whether the file at path exists and was modified no earlier than the one
+// at source
+inline bool FileIsNewer(const string &path, const string &source)
+{
+    struct stat target, origin;
+    if (stat(path.c_str(), &target) != 0)
+	return false;
+    if (stat(source.c_str(), &origin) != 0)
+	return true; // nothing to be stale against
+    if (target.st_mtim.tv_sec != origin.st_mtim.tv_sec)
+	return target.st_mtim.tv_sec > origin.st_mtim.tv_sec;
+    return target.st_mtim.tv_nsec >= origin.st_mtim.tv_nsec;
+}
+
+// reads and decodes an image file, touches no GL state so it is safe to call
+// from worker threads. A pre-compressed "<file>.dds" next to the file, e.g.
+// "wood.png.dds" (see tools/texture_compress), is preferred when it is not
+// older than the file and the driver supports its format; otherwise the
+// file itself is decoded with stb. With hashContent the encoded bytes are
+// hashed as well, for content based deduplication.
+ImageData DecodeImage(const string &filename, bool hashContent)
+{
+    ImageData image;
+    string ddsPath = filename + ".dds";
+    if (FileIsNewer(ddsPath, filename)) {
+	MappedFile dds(ddsPath);
+	if (dds.IsOpen()) {
+	    image.compressed = ParseDDS(dds.data(), dds.size());
+	    if (image.compressed.IsValid() &&
+		CompressedFormatSupported(image.compressed.format)) {
+		image.width = image.compressed.levels[0].width;
+		image.height = image.compressed.levels[0].height;
+		if (hashContent)
+		    image.contentHash = hashBytes(dds.data(), dds.size());
+		return image;
+	    }
+	    image.compressed = DDSImage();
+	}
+    } else if (access(ddsPath.c_str(), F_OK) == 0) {
+	std::cout << "WARNING::TEXTURE:: " << ddsPath
+		  << " is older than its source, decoding the source"
+		  << std::endl;
+    }
+
+    MappedFile file(filename);
+    if (file.IsOpen()) {
+	if (hashContent)
+	    image.contentHash = hashBytes(file.data(), file.size());
+	image.pixels = stbi_load_from_memory(
+	    file.data(), (int)file.size(), &image.width, &image.height,
+	    &image.components, 0);
+    }
+    if (!image.pixels) {
+	std::cout << "Texture failed to load at path: " << filename
+		  << std::endl;
+	image.contentHash = 0;
+    }
+    return image;
+}
 
+// creates a mipmapped 2D texture from decoded pixels or a compressed mip
+// chain. A failed decode still yields a texture name, matching what
+// TextureFromFile always did.
+unsigned int UploadTexture(const ImageData &image)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data =
-	stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
+    const DDSImage &dds = image.compressed;
+    if (dds.IsValid()) {
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	for (size_t level = 0; level < dds.levels.size(); level++) {
+	    const DDSImage::Level &mip = dds.levels[level];
+	    glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, dds.format,
+				   mip.width, mip.height, 0, (GLsizei)mip.size,
+				   dds.data.data() + mip.offset);
+	}
+	// the chain may stop short of 1x1, don't sample missing levels
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+			(GLint)dds.levels.size() - 1);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    } else if (image.pixels) {
 	GLenum format;
-	if (nrComponents == 1)
+	if (image.components == 1)
 	    format = GL_RED;
-	else if (nrComponents == 3)
+	else if (image.components == 3)
 	    format = GL_RGB;
-	else if (nrComponents == 4)
+	else if (image.components == 4)
 	    format = GL_RGBA;
 
 	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-		     GL_UNSIGNED_BYTE, data);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0,
+		     format, GL_UNSIGNED_BYTE, image.pixels);
 	glGenerateMipmap(GL_TEXTURE_2D);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -264,13 +870,20 @@ unsigned int TextureFromFile(const char *path, const string &directory,
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
 			GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	stbi_image_free(data);
-    } else {
-	std::cout << "Texture failed to load at path: " << path << std::endl;
-	stbi_image_free(data);
     }
 
     return textureID;
 }
+
+unsigned int TextureFromFile(const char *path, const string &directory,
+			     bool gamma)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
+
+    ImageData image = DecodeImage(filename);
+    unsigned int textureID = UploadTexture(image);
+    stbi_image_free(image.pixels);
+    return textureID;
+}
 #endif
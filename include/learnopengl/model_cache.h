@@ -0,0 +1,92 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <learnopengl/async_model.h>
+#include <learnopengl/model.h>
+
+#include <common.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// hands out shared, reference-counted models so that every placement of the
+// same asset uses one import, one set of GPU buffers and one set of textures.
+// Only per-instance state (the model matrix) lives with the caller. A model is
+// freed once its last shared_ptr goes away, the cache only keeps weak
+// references.
+class ModelCache
+{
+  public:
+    shared_ptr<Model> Load(const string &path, bool gamma = false,
+			   ModelOptions options = ModelOptions())
+    {
+	string key = cacheKey(path, gamma, options);
+	// a model still streaming in is finished rather than imported twice
+	shared_ptr<AsyncModel> loading = pending[key].lock();
+	if (loading) {
+	    loading->Finish();
+	    return loading->Get();
+	}
+	shared_ptr<Model> model = models[key].lock();
+	if (!model) {
+	    model = make_shared<Model>(path, gamma, options);
+	    models[key] = model;
+	}
+	return model;
+    }
+
+    // like Load, but returns a handle right away and imports in the
+    // background (see AsyncModel). Requests for a model that is loaded or
+    // already streaming in share it.
+    shared_ptr<AsyncModel> LoadAsync(const string &path, bool gamma = false,
+				     ModelOptions options = ModelOptions())
+    {
+	string key = cacheKey(path, gamma, options);
+	shared_ptr<AsyncModel> loading = pending[key].lock();
+	if (loading)
+	    return loading;
+	shared_ptr<Model> model = models[key].lock();
+	if (model) {
+	    loading = make_shared<AsyncModel>(model);
+	} else {
+	    loading = make_shared<AsyncModel>(path, gamma, options);
+	    models[key] = loading->model;
+	}
+	pending[key] = loading;
+	return loading;
+    }
+
+    // number of distinct models that are still alive
+    size_t Size() const
+    {
+	size_t alive = 0;
+	for (const auto &entry : models)
+	    if (!entry.second.expired())
+		alive++;
+	return alive;
+    }
+
+  private:
+    unordered_map<string, weak_ptr<Model>> models;
+    unordered_map<string, weak_ptr<AsyncModel>> pending;
+
+    // models differing in options own different GPU buffers or CPU data
+    static string cacheKey(const string &path, bool gamma,
+			   const ModelOptions &options)
+    {
+	string key = canonicalPath(path) + (gamma ? "#gamma" : "");
+	if (options.vertexFormat == VertexFormat::Packed)
+	    key += "#packed";
+	if (options.storage == MeshStorage::Shared)
+	    key += "#shared";
+	if (options.geometry == GeometryRetention::Positions)
+	    key += "#positions";
+	else if (options.geometry == GeometryRetention::None)
+	    key += "#gpu-only";
+	if (options.attributes != VERTEX_ALL_ATTRIBUTES)
+	    key += "#attributes" + to_string(options.attributes);
+	return key;
+    }
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// runs body(i) for every i in [0, count) on a pool of worker threads sized to
+// the machine, and returns once all of them are done. body must not touch
+// OpenGL, the context is only current on the calling thread.
+template <typename Body> void ParallelFor(size_t count, Body body)
+{
+    if (count == 0)
+	return;
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, count);
+    if (workers == 1) {
+	for (size_t i = 0; i < count; i++)
+	    body(i);
+	return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+	for (size_t i = next++; i < count; i = next++)
+	    body(i);
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t t = 1; t < workers; t++)
+	threads.emplace_back(work);
+    // the calling thread takes a share of the work instead of idling
+    work();
+    for (std::thread &thread : threads)
+	thread.join();
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/mapped_file.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <common.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (ARB_get_program_binary), one
+// file per program in PROGRAM_CACHE_DIRECTORY, named by a hash of the
+// program's shader paths. Layout:
+//   ProgramCacheHeader
+//   the driver's binary, header.length bytes
+// The header key hashes the sources as compiled and the driver's vendor,
+// renderer and version strings. An edited shader or another driver makes
+// the binary stale; the program is then compiled from source and stored
+// again. Binaries are a driver-private format, never commit them.
+const char *const PROGRAM_CACHE_DIRECTORY = "resources/shaders/cache";
+const uint32_t PROGRAM_CACHE_MAGIC = 0x47525050; // "PPRG"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t length;
+    // what compiling and linking from source took when the binary was
+    // stored, so a hit knows how much startup time it saved
+    uint64_t compileMicroseconds;
+};
+
+class ProgramCache
+{
+  public:
+    struct Stats {
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	double loadMicroseconds = 0.0;	  // linking the hits from binaries
+	double compileMicroseconds = 0.0; // compiling the misses
+	double savedMicroseconds = 0.0;	  // hits' compile time minus load
+    };
+
+    static ProgramCache &Instance()
+    {
+	static ProgramCache cache;
+	return cache;
+    }
+
+    // hashes the sources of a program as they are handed to the compiler
+    static uint64_t HashSources(const std::vector<std::string> &sources)
+    {
+	uint64_t hash = HASH_SEED;
+	for (const std::string &source : sources) {
+	    uint64_t size = source.size();
+	    hash = hashBytes(&size, sizeof(size), hash);
+	    hash = hashBytes(source.data(), source.size(), hash);
+	}
+	return hash;
+    }
+
+    // links program from the binary stored under name. Returns false on a
+    // missing, stale or rejected binary; program is then a fresh, empty
+    // program object to compile into.
+    bool Load(GLuint &program, const std::string &name, uint64_t sourceHash)
+    {
+	const ProgramBinaryFunctions &binaries =
+	    GLExtensions::ProgramBinaries();
+	if (!binaries.IsSupported())
+	    return miss();
+	auto start = std::chrono::steady_clock::now();
+	MappedFile file(path(name));
+	if (!file.IsOpen() || file.size() < sizeof(ProgramCacheHeader))
+	    return miss();
+	ProgramCacheHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != PROGRAM_CACHE_MAGIC ||
+	    header.version != PROGRAM_CACHE_VERSION ||
+	    header.key != key(sourceHash) ||
+	    sizeof(header) + (size_t)header.length > file.size())
+	    return miss();
+
+	binaries.programBinary(program, header.binaryFormat,
+			       file.data() + sizeof(header),
+			       (GLsizei)header.length);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) {
+	    // the driver may reject its own binaries, e.g. after an update
+	    // that kept the version string
+	    glDeleteProgram(program);
+	    program = glCreateProgram();
+	    return miss();
+	}
+	double micros = std::chrono::duration<double, std::micro>(
+			    std::chrono::steady_clock::now() - start)
+			    .count();
+	stats.hits++;
+	stats.loadMicroseconds += micros;
+	stats.savedMicroseconds += (double)header.compileMicroseconds - micros;
+	return true;
+    }
+
+    // asks the driver to keep the binary of program retrievable, call
+    // before linking a program that will be stored
+    void PrepareLink(GLuint program) const
+    {
+	const ProgramBinaryFunctions &binaries =
+	    GLExtensions::ProgramBinaries();
+	if (binaries.IsSupported())
+	    binaries.programParameteri(
+		program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // stores the binary of a program linked from source under name. The
+    // file is written under a temporary name and renamed so a crashed write
+    // never leaves a truncated binary.
+    void Store(GLuint program, const std::string &name, uint64_t sourceHash,
+	       double compileMicroseconds)
+    {
+	stats.compileMicroseconds += compileMicroseconds;
+	const ProgramBinaryFunctions &binaries =
+	    GLExtensions::ProgramBinaries();
+	GLint linked = GL_FALSE, length = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!binaries.IsSupported() || !linked)
+	    return;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	    return;
+	std::vector<char> binary((size_t)length);
+	GLenum binaryFormat = 0;
+	binaries.getProgramBinary(program, length, &length, &binaryFormat,
+				  binary.data());
+
+	ProgramCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key(sourceHash);
+	header.binaryFormat = binaryFormat;
+	header.length = (uint32_t)length;
+	header.compileMicroseconds = (uint64_t)compileMicroseconds;
+
+	mkdir(PROGRAM_CACHE_DIRECTORY, 0755); // fails harmlessly if it exists
+	std::string cachePath = path(name);
+	std::string tmpPath = cachePath + ".tmp";
+	std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+	out.write((const char *)&header, sizeof(header));
+	out.write(binary.data(), length);
+	out.close();
+	if (!out || std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+	    std::remove(tmpPath.c_str());
+	    std::cout << "WARNING::PROGRAM_CACHE:: failed to write "
+		      << cachePath << std::endl;
+	}
+    }
+
+    const Stats &GetStats() const { return stats; }
+
+    void Report(std::ostream &out) const
+    {
+	out << "ProgramCache: " << stats.hits << " of "
+	    << stats.hits + stats.misses << " programs from binaries ("
+	    << stats.loadMicroseconds / 1000.0 << " ms), "
+	    << stats.compileMicroseconds / 1000.0 << " ms compiling, "
+	    << stats.savedMicroseconds / 1000.0 << " ms of startup saved"
+	    << std::endl;
+    }
+
+  private:
+    Stats stats;
+    uint64_t driverHash = 0;
+
+    ProgramCache() = default;
+
+    bool miss()
+    {
+	stats.misses++;
+	return false;
+    }
+
+    static std::string path(const std::string &name)
+    {
+	char file[32];
+	std::snprintf(file, sizeof(file), "/%016llx.program",
+		      (unsigned long long)hashBytes(name.data(), name.size()));
+	return PROGRAM_CACHE_DIRECTORY + std::string(file);
+    }
+
+    // the sources combined with the driver identity
+    uint64_t key(uint64_t sourceHash)
+    {
+	if (!driverHash) {
+	    driverHash = HASH_SEED;
+	    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+		const char *value = (const char *)glGetString(name);
+		if (value)
+		    driverHash =
+			hashBytes(value, std::strlen(value) + 1, driverHash);
+	    }
+	}
+	return hashBytes(&sourceHash, sizeof(sourceHash), driverHash);
+    }
+};
+
+#endif
@@ -0,0 +1,436 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <chrono>
+#include <common.h>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// texture unit the transform buffer of batched draws is bound to, above the
+// units meshes bind their textures to
+const GLuint TRANSFORM_BUFFER_UNIT = 15;
+// RGBA32F texels per transform: four matrix columns, then bob phase and
+// amplitude as in InstanceData
+const GLint TRANSFORM_TEXELS = 5;
+
+// the uniforms a program drawing meshes is placed with (see RenderQueue),
+// resolved once so setting them per command needs no name lookups
+struct PlacementUniforms {
+    Uniform<int> instanced;
+    Uniform<int> batched;
+    Uniform<int> transforms;
+    Uniform<int> transformIndex;
+
+    PlacementUniforms() = default;
+    explicit PlacementUniforms(Shader &shader)
+	: instanced(shader.GetUniform<int>("instanced")),
+	  batched(shader.GetUniform<int>("batched")),
+	  transforms(shader.GetUniform<int>("transforms")),
+	  transformIndex(shader.GetUniform<int>("transformIndex"))
+    {
+    }
+};
+
+// passes of the scene, drawn in this order whatever order they were
+// submitted in
+enum class RenderPass : uint8_t { Opaque = 0, Sky = 1 };
+
+// one draw collected by RenderQueue. A command draws either a mesh (with
+// its baked textures, instanced when instanceCount > 0) or, without a mesh,
+// vertexCount vertices of vao with texture bound on unit 0. A mesh command
+// with a transformIndex is placed by that entry of the queue's transform
+// buffer, and may be merged with its neighbours into a multi-draw.
+struct RenderCommand {
+    RenderPass pass = RenderPass::Opaque;
+    const PipelineState *pipeline = nullptr;
+    Shader *shader = nullptr;
+    Mesh *mesh = nullptr;
+    GLuint vao = 0; // for a mesh: its model's shared VAO, or 0
+    GLsizei instanceCount = 0;
+    GLint transformIndex = -1; // see RenderQueue::AddTransform
+    GLenum textureTarget = GL_TEXTURE_2D;
+    GLuint texture = 0;
+    GLsizei vertexCount = 0;
+    float depth = 0.0f; // distance from the eye, see RenderQueue::Distance
+};
+
+// collects a frame's draws and submits them sorted by a 64-bit key:
+//   63..60  pass
+//   59..48  program
+//   47..32  material (the set of textures)
+//   31..0   depth, front to back
+// so passes stay ordered, programs and texture sets are switched as rarely
+// as possible and, within a material, near geometry is drawn first to fill
+// the depth buffer early. Programs and materials are mapped to small ids on
+// first sight.
+//
+// After sorting, consecutive commands with the same placement (transform
+// index), program, textures, pipeline and shared VAO are submitted as one
+// glMultiDrawElementsBaseVertex. The core 3.3 loader has no gl_DrawIDARB, so
+// the transform index is a uniform set per multi-draw: batching merges the
+// meshes of a placement, not placements.
+//
+// Shaders drawing meshes select where the model matrix comes from with a
+// bool "instanced" uniform (instance attributes), a bool "batched" uniform
+// and an int "transformIndex" (the samplerBuffer "transforms"); the queue
+// sets them per mesh command, through handles resolved on a program's first
+// command. The shaders must outlive the queue.
+class RenderQueue
+{
+  public:
+    // what the last Flush() submitted. The state changes count how often
+    // program, textures, VAO or pipeline differ between consecutive
+    // commands, in submission order and after sorting. The CPU time covers
+    // sorting and issuing the GL calls, not the GPU work.
+    struct Stats {
+	// bounds tested against the frustum before anything was queued:
+	// model instances, and meshes of the instances in view
+	struct Culling {
+	    unsigned int modelsVisible = 0;
+	    unsigned int modelsCulled = 0;
+	    unsigned int meshesVisible = 0;
+	    unsigned int meshesCulled = 0;
+	};
+
+	Culling culling;
+	unsigned int commands = 0;
+	unsigned int drawCalls = 0; // glDraw* calls issued
+	unsigned int changesUnsorted = 0;
+	unsigned int changesSorted = 0;
+	double cpuMicroseconds = 0.0;
+
+	// negative if sorting made it worse
+	int ChangesRemoved() const
+	{
+	    return (int)changesUnsorted - (int)changesSorted;
+	}
+    };
+
+    RenderQueue() = default;
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    ~RenderQueue()
+    {
+	glDeleteTextures(1, &transformTexture);
+	glDeleteBuffers(1, &transformBuffer);
+    }
+
+    // starts a frame seen from eye through frustum, dropping the previous
+    // frame's commands and transforms
+    void Begin(const glm::vec3 &eye, const Frustum &frustum)
+    {
+	this->eye = eye;
+	this->frustum = frustum;
+	culling = Stats::Culling();
+	commands.clear();
+	transforms.clear();
+    }
+
+    // whether the world-space bounds of a model instance, or of a mesh in
+    // one, intersect the frame's frustum. Callers skip what is not, before
+    // any GL work; the results are counted in Stats::culling.
+    bool ModelInView(const Bounds &bounds)
+    {
+	bool visible = frustum.Intersects(bounds);
+	(visible ? culling.modelsVisible : culling.modelsCulled)++;
+	return visible;
+    }
+    bool MeshInView(const Bounds &bounds)
+    {
+	bool visible = frustum.Intersects(bounds);
+	(visible ? culling.meshesVisible : culling.meshesCulled)++;
+	return visible;
+    }
+
+    // adds a placement to the frame's transform buffer, returns the index
+    // for RenderCommand::transformIndex
+    GLint AddTransform(const InstanceData &instance)
+    {
+	GLint index = (GLint)(transforms.size() / TRANSFORM_TEXELS);
+	for (int column = 0; column < 4; column++)
+	    transforms.push_back(instance.transform[column]);
+	transforms.push_back(glm::vec4(instance.bobPhase,
+				       instance.bobAmplitude, 0.0f, 0.0f));
+	return index;
+    }
+
+    // distance of point from the eye, for RenderCommand::depth
+    float Distance(const glm::vec3 &point) const
+    {
+	return glm::length(point - eye);
+    }
+
+    void Submit(const RenderCommand &command) { commands.push_back(command); }
+
+    // sorts and draws the collected commands
+    void Flush()
+    {
+	auto start = std::chrono::steady_clock::now();
+	stats = Stats();
+	stats.culling = culling;
+	stats.commands = (unsigned int)commands.size();
+	if (commands.empty())
+	    return;
+	uploadTransforms();
+
+	keys.resize(commands.size());
+	for (size_t i = 0; i < commands.size(); i++) {
+	    keys[i].key = sortKey(commands[i]);
+	    keys[i].index = (uint32_t)i;
+	}
+	for (size_t i = 1; i < keys.size(); i++)
+	    stats.changesUnsorted += stateChanges(keys[i - 1], keys[i]);
+	radixSort();
+	for (size_t i = 1; i < keys.size(); i++)
+	    stats.changesSorted += stateChanges(keys[i - 1], keys[i]);
+
+	for (size_t first = 0; first < keys.size();) {
+	    size_t last = first + 1;
+	    while (last < keys.size() && mergeable(commands[keys[first].index],
+						   commands[keys[last].index]))
+		last++;
+	    if (last - first > 1)
+		multiDraw(first, last);
+	    else
+		execute(commands[keys[first].index]);
+	    first = last;
+	}
+
+	stats.cpuMicroseconds =
+	    std::chrono::duration<double, std::micro>(
+		std::chrono::steady_clock::now() - start)
+		.count();
+    }
+
+    const Stats &LastFlush() const { return stats; }
+
+  private:
+    struct SortEntry {
+	uint64_t key;
+	uint32_t index;
+    };
+
+    static const unsigned int PROGRAM_BITS = 12;
+    static const unsigned int MATERIAL_BITS = 16;
+
+    glm::vec3 eye = glm::vec3(0.0f);
+    Frustum frustum = Frustum::Everything();
+    Stats::Culling culling;
+    std::vector<RenderCommand> commands;
+    std::vector<SortEntry> keys, scratch;
+    std::unordered_map<GLuint, uint32_t> programIds;
+    std::unordered_map<uint64_t, uint32_t> materialIds;
+    std::unordered_map<Shader *, PlacementUniforms> placements;
+    Stats stats;
+    // the frame's transforms and the texture buffer they are read through
+    std::vector<glm::vec4> transforms;
+    GLuint transformBuffer = 0, transformTexture = 0;
+    // arguments of a multi-draw, kept to avoid allocations
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+    std::vector<GLint> baseVertices;
+
+    void uploadTransforms()
+    {
+	if (transforms.empty())
+	    return;
+	GLState &state = GLState::Instance();
+	if (!transformBuffer) {
+	    glGenBuffers(1, &transformBuffer);
+	    glGenTextures(1, &transformTexture);
+	    state.BindTexture(TRANSFORM_BUFFER_UNIT, GL_TEXTURE_BUFFER,
+			      transformTexture);
+	    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transformBuffer);
+	}
+	// stays bound on its unit for the whole flush
+	state.BindTexture(TRANSFORM_BUFFER_UNIT, GL_TEXTURE_BUFFER,
+			  transformTexture);
+	glBindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, transforms.size() * sizeof(glm::vec4),
+		     transforms.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    uint64_t sortKey(const RenderCommand &command)
+    {
+	uint64_t program =
+	    denseId(programIds, command.shader->ID, PROGRAM_BITS);
+	uint64_t material =
+	    denseId(materialIds, materialOf(command), MATERIAL_BITS);
+	// a non-negative float's bits order like the float itself
+	float depth = command.depth > 0.0f ? command.depth : 0.0f;
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+	return (uint64_t)command.pass << 60 | program << 48 | material << 32 |
+	       depthBits;
+    }
+
+    // ids beyond the field width wrap, which only costs sorting quality
+    template <typename Key>
+    static uint64_t denseId(std::unordered_map<Key, uint32_t> &ids, Key key,
+			    unsigned int bits)
+    {
+	auto it = ids.find(key);
+	if (it == ids.end())
+	    it = ids.emplace(key, (uint32_t)ids.size()).first;
+	return it->second & ((1u << bits) - 1);
+    }
+
+    // a hash of the textures a command binds
+    static uint64_t materialOf(const RenderCommand &command)
+    {
+	uint64_t hash = HASH_SEED;
+	if (!command.mesh)
+	    return hashBytes(&command.texture, sizeof(command.texture), hash);
+	for (const Texture &texture : command.mesh->textures)
+	    hash = hashBytes(&texture.id, sizeof(texture.id), hash);
+	return hash;
+    }
+
+    // the number of program, material, VAO and pipeline switches between
+    // two consecutive commands
+    unsigned int stateChanges(const SortEntry &a, const SortEntry &b) const
+    {
+	const uint64_t materialMask = ((1ull << MATERIAL_BITS) - 1) << 32;
+	const RenderCommand &ca = commands[a.index];
+	const RenderCommand &cb = commands[b.index];
+	return (ca.shader->ID != cb.shader->ID) +
+	       ((a.key & materialMask) != (b.key & materialMask)) +
+	       (vaoOf(ca) != vaoOf(cb)) + (ca.pipeline != cb.pipeline);
+    }
+
+    static GLuint vaoOf(const RenderCommand &command)
+    {
+	if (command.mesh && !command.vao)
+	    return command.mesh->VAO;
+	return command.vao;
+    }
+
+    // LSD radix sort on the keys, 8 bits per pass. Stable, so commands with
+    // equal keys keep their submission order. Passes over bytes all keys
+    // share are skipped, which with few programs and materials are most.
+    void radixSort()
+    {
+	scratch.resize(keys.size());
+	for (unsigned int shift = 0; shift < 64; shift += 8) {
+	    size_t offsets[256] = {};
+	    for (const SortEntry &entry : keys)
+		offsets[(entry.key >> shift) & 0xff]++;
+	    if (offsets[(keys[0].key >> shift) & 0xff] == keys.size())
+		continue;
+	    size_t sum = 0;
+	    for (size_t &offset : offsets) {
+		size_t count = offset;
+		offset = sum;
+		sum += count;
+	    }
+	    for (const SortEntry &entry : keys)
+		scratch[offsets[(entry.key >> shift) & 0xff]++] = entry;
+	    keys.swap(scratch);
+	}
+    }
+
+    // whether b can join the multi-draw a is part of: same placement, same
+    // state, and geometry in the same shared buffers
+    static bool mergeable(const RenderCommand &a, const RenderCommand &b)
+    {
+	return a.mesh && b.mesh && a.transformIndex >= 0 &&
+	       a.transformIndex == b.transformIndex && a.vao &&
+	       a.vao == b.vao && a.shader == b.shader &&
+	       a.pipeline == b.pipeline && a.instanceCount == 0 &&
+	       b.instanceCount == 0 && a.mesh->sharedBuffers &&
+	       b.mesh->sharedBuffers &&
+	       a.mesh->indexType == b.mesh->indexType &&
+	       sameTextures(*a.mesh, *b.mesh);
+    }
+
+    static bool sameTextures(const Mesh &a, const Mesh &b)
+    {
+	if (a.textures.size() != b.textures.size())
+	    return false;
+	for (size_t i = 0; i < a.textures.size(); i++)
+	    if (a.textures[i].id != b.textures[i].id)
+		return false;
+	return true;
+    }
+
+    // sets the pipeline, program and placement uniforms for a command
+    void prepare(const RenderCommand &command)
+    {
+	GLState &state = GLState::Instance();
+	if (command.pipeline)
+	    state.Apply(*command.pipeline);
+	command.shader->use();
+	if (!command.mesh)
+	    return;
+	const PlacementUniforms &placement = placementOf(command.shader);
+	bool batched = command.transformIndex >= 0;
+	placement.instanced.Set(command.instanceCount > 0);
+	placement.batched.Set(batched);
+	// on every path: left at unit 0 the samplerBuffer would share a unit
+	// with the mesh's sampler2D, which fails every draw
+	placement.transforms.Set(TRANSFORM_BUFFER_UNIT);
+	if (batched)
+	    placement.transformIndex.Set(command.transformIndex);
+	if (command.vao)
+	    state.BindVertexArray(command.vao);
+    }
+
+    const PlacementUniforms &placementOf(Shader *shader)
+    {
+	auto it = placements.find(shader);
+	if (it == placements.end())
+	    it = placements.emplace(shader, PlacementUniforms(*shader)).first;
+	return it->second;
+    }
+
+    void execute(const RenderCommand &command)
+    {
+	GLState &state = GLState::Instance();
+	prepare(command);
+	stats.drawCalls++;
+	if (command.mesh) {
+	    command.mesh->DrawInstanced(*command.shader,
+					command.instanceCount);
+	} else {
+	    state.BindVertexArray(command.vao);
+	    state.BindTexture(0, command.textureTarget, command.texture);
+	    glDrawArrays(GL_TRIANGLES, 0, command.vertexCount);
+	}
+    }
+
+    // draws the sorted commands [first, last), which are mergeable, with
+    // one call
+    void multiDraw(size_t first, size_t last)
+    {
+	const RenderCommand &command = commands[keys[first].index];
+	prepare(command);
+	command.mesh->Bind(*command.shader);
+	counts.clear();
+	offsets.clear();
+	baseVertices.clear();
+	for (size_t i = first; i < last; i++) {
+	    const Mesh &mesh = *commands[keys[i].index].mesh;
+	    counts.push_back((GLsizei)mesh.indexCount);
+	    offsets.push_back((const void *)mesh.indexOffset);
+	    baseVertices.push_back(mesh.baseVertex);
+	}
+	glMultiDrawElementsBaseVertex(
+	    GL_TRIANGLES, counts.data(), command.mesh->indexType,
+	    offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+	stats.drawCalls++;
+    }
+};
+
+#endif
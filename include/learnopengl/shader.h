@@ -4,11 +4,99 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/gl_state.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/shader_preprocessor.h>
+#include <learnopengl/startup_timeline.h>
+
+#include <chrono>
 #include <common.h>
-#include <fstream>
+#include <cstring>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// an active uniform of a linked program, with the last value uploaded to it
+struct UniformInfo {
+    GLint location = -1; // -1 for names the program doesn't have
+    GLenum type = 0;
+    GLint size = 0;
+    // shadow copy of the current value, large enough for a mat4
+    unsigned char shadow[sizeof(glm::mat4)];
+    unsigned char shadowSize = 0; // 0 until the first upload
+};
+
+// glUniform* for each supported value type
+inline void UploadUniform(GLint location, int value)
+{
+    glUniform1i(location, value);
+}
+inline void UploadUniform(GLint location, float value)
+{
+    glUniform1f(location, value);
+}
+inline void UploadUniform(GLint location, const glm::vec2 &value)
+{
+    glUniform2fv(location, 1, &value[0]);
+}
+inline void UploadUniform(GLint location, const glm::vec3 &value)
+{
+    glUniform3fv(location, 1, &value[0]);
+}
+inline void UploadUniform(GLint location, const glm::vec4 &value)
+{
+    glUniform4fv(location, 1, &value[0]);
+}
+inline void UploadUniform(GLint location, const glm::mat2 &value)
+{
+    glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]);
+}
+inline void UploadUniform(GLint location, const glm::mat3 &value)
+{
+    glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+}
+inline void UploadUniform(GLint location, const glm::mat4 &value)
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+// uploads value unless it equals the shadowed one. The program must be in use.
+template <typename T> void SetUniform(UniformInfo &info, const T &value)
+{
+    static_assert(sizeof(T) <= sizeof(UniformInfo::shadow),
+		  "uniform value does not fit the shadow copy");
+    if (info.location < 0)
+	return;
+    if (info.shadowSize == sizeof(T) &&
+	std::memcmp(info.shadow, &value, sizeof(T)) == 0)
+	return;
+    std::memcpy(info.shadow, &value, sizeof(T));
+    info.shadowSize = sizeof(T);
+    UploadUniform(info.location, value);
+}
+
+// typed handle to a uniform, resolved once by Shader::GetUniform so setting
+// it needs no name lookup. Handles to names the program lacks do nothing.
+template <typename T> class Uniform
+{
+  public:
+    Uniform() = default;
+    explicit Uniform(UniformInfo *info) : info(info) {}
+
+    void Set(const T &value) const
+    {
+	if (info)
+	    SetUniform(*info, value);
+    }
+
+    bool IsActive() const { return info && info->location >= 0; }
+
+  private:
+    UniformInfo *info = nullptr;
+};
+
 class Shader
 {
   public:
@@ -16,156 +104,446 @@ class Shader
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char *vertexPath, const char *fragmentPath,
-	   const char *geometryPath = nullptr)
+	   const char *geometryPath = nullptr,
+	   const ShaderDefines &defines = ShaderDefines())
+	: defines(defines)
     {
-	std::string vertexPathString(vertexPath);
-	std::string fragmentPathString(fragmentPath);
-
-	vertexPath = vertexPathString.c_str();
-	fragmentPath = fragmentPathString.c_str();
+	paths.push_back(vertexPath);
+	paths.push_back(fragmentPath);
+	if (geometryPath != nullptr)
+	    paths.push_back(geometryPath);
 	// 1. retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
 	std::string geometryCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	std::ifstream gShaderFile;
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try {
-	    // open files
-	    vShaderFile.open(vertexPath);
-	    fShaderFile.open(fragmentPath);
-	    std::stringstream vShaderStream, fShaderStream;
-	    // read file's buffer contents into streams
-	    vShaderStream << vShaderFile.rdbuf();
-	    fShaderStream << fShaderFile.rdbuf();
-	    // close file handlers
-	    vShaderFile.close();
-	    fShaderFile.close();
-	    // convert stream into string
-	    vertexCode = vShaderStream.str();
-	    fragmentCode = fShaderStream.str();
-	    // if geometry shader path is present, also load a geometry shader
-	    if (geometryPath != nullptr) {
-		std::string geometryPathString(geometryPath);
-		geometryPath = geometryPathString.c_str();
-		gShaderFile.open(geometryPath);
-		std::stringstream gShaderStream;
-		gShaderStream << gShaderFile.rdbuf();
-		gShaderFile.close();
-		geometryCode = gShaderStream.str();
-	    }
-	} catch (std::ifstream::failure &e) {
-	    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ"
-		      << std::endl;
-	}
-	const char *vShaderCode = vertexCode.c_str();
-	const char *fShaderCode = fragmentCode.c_str();
-	// 2. compile shaders
-	unsigned int vertex, fragment;
-	// vertex shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-	checkCompileErrors(vertex, "VERTEX");
-	// fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	checkCompileErrors(fragment, "FRAGMENT");
-	// if geometry shader is given, compile geometry shader
-	unsigned int geometry;
-	if (geometryPath != nullptr) {
-	    const char *gShaderCode = geometryCode.c_str();
-	    geometry = glCreateShader(GL_GEOMETRY_SHADER);
-	    glShaderSource(geometry, 1, &gShaderCode, NULL);
-	    glCompileShader(geometry);
-	    checkCompileErrors(geometry, "GEOMETRY");
-	}
-	// shader Program
+	readSources(vertexCode, fragmentCode, geometryCode);
+	// 2. link from the program binary cache, or hand the sources to the
+	// driver. Nothing waits for the compile here, its status is queried
+	// when the program is first needed (see resolve), so with
+	// KHR_parallel_shader_compile it runs alongside whatever comes next.
 	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	if (geometryPath != nullptr)
-	    glAttachShader(ID, geometry);
-	glLinkProgram(ID);
-	checkCompileErrors(ID, "PROGRAM");
-	// delete the shaders as they're linked into our program now and no
-	// longer necessery
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
-	if (geometryPath != nullptr)
-	    glDeleteShader(geometry);
+	if (loadProgram(ID, vertexCode, fragmentCode, geometryCode)) {
+	    reflectUniforms();
+	} else {
+	    submitProgram(ID, vertexCode, fragmentCode, geometryCode);
+	    pending = true;
+	}
     }
     // activate the shader
     // ------------------------------------------------------------------------
-    void use() { glUseProgram(ID); }
-    // utility uniform functions
+    void use()
+    {
+	resolve();
+	GLState::Instance().UseProgram(ID);
+    }
+    // utility uniform functions, a program still compiling is finished
+    // first so the value isn't dropped
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const std::string &name, bool value)
     {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	SetUniform(resolvedUniform(name), (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const std::string &name, int value)
     {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	SetUniform(resolvedUniform(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const std::string &name, float value)
     {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	SetUniform(resolvedUniform(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const std::string &name, const glm::vec2 &value)
     {
-	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	SetUniform(resolvedUniform(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const std::string &name, float x, float y)
     {
-	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	SetUniform(resolvedUniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const std::string &name, const glm::vec3 &value)
     {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	SetUniform(resolvedUniform(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const std::string &name, float x, float y, float z)
     {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	SetUniform(resolvedUniform(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const std::string &name, const glm::vec4 &value)
     {
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	SetUniform(resolvedUniform(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	SetUniform(resolvedUniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const std::string &name, const glm::mat2 &mat)
     {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-			   &mat[0][0]);
+	SetUniform(resolvedUniform(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(const std::string &name, const glm::mat3 &mat)
+    {
+	SetUniform(resolvedUniform(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(const std::string &name, const glm::mat4 &mat)
+    {
+	SetUniform(resolvedUniform(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    // attaches the uniform block called name to a binding point, programs
+    // without that block are left alone
+    void bindUniformBlock(const char *name, GLuint binding)
+    {
+	blockBindings.emplace_back(name, binding);
+	if (!pending)
+	    attachUniformBlock(name, binding);
+    }
+    // ------------------------------------------------------------------------
+    // the vertex attribute locations the program actually reads, bit n set
+    // for location n. Attributes the compiler optimized away are not active
+    // and so not included.
+    unsigned int ActiveAttributes()
+    {
+	resolve();
+	unsigned int mask = 0;
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	std::string name(maxLength > 0 ? maxLength : 1, '\0');
+	for (GLint i = 0; i < count; i++) {
+	    GLsizei length = 0;
+	    GLint size = 0;
+	    GLenum type = 0;
+	    glGetActiveAttrib(ID, (GLuint)i, (GLsizei)name.size(), &length,
+			      &size, &type, &name[0]);
+	    std::string attributeName(name.data(), length);
+	    GLint location = glGetAttribLocation(ID, attributeName.c_str());
+	    if (location >= 0 && location < 32)
+		mask |= 1u << location;
+	}
+	return mask;
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    // resolves name once; setting the handle is a direct, shadowed
+    // glUniform* call. Handles stay valid for the lifetime of the shader.
+    template <typename T> Uniform<T> GetUniform(const std::string &name)
     {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-			   &mat[0][0]);
+	return Uniform<T>(&resolvedUniform(name));
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    // re-reads the sources and replaces the program with one built from
+    // them. If they fail to compile or link the previous program stays in
+    // use and false is returned. ID changes, but uniform handles and block
+    // bindings stay valid and the last value set to each uniform is
+    // uploaded to the new program, which is left in use.
+    bool Reload()
     {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-			   &mat[0][0]);
+	resolve();
+	std::string vertexCode, fragmentCode, geometryCode;
+	if (!readSources(vertexCode, fragmentCode, geometryCode))
+	    return false;
+	GLuint program = glCreateProgram();
+	bool linked = loadProgram(program, vertexCode, fragmentCode,
+				  geometryCode);
+	if (!linked) {
+	    submitProgram(program, vertexCode, fragmentCode, geometryCode);
+	    linked = finishProgram(program);
+	}
+	if (!linked) {
+	    glDeleteProgram(program);
+	    std::cout << "WARNING::SHADER:: keeping program " << ID << " of "
+		      << paths[1] << std::endl;
+	    return false;
+	}
+	glDeleteProgram(ID);
+	ID = program;
+	for (const auto &block : blockBindings)
+	    attachUniformBlock(block.first.c_str(), block.second);
+	reflectUniforms();
+	// the deleted name may be reused, don't trust the tracked program
+	GLState::Instance().Invalidate();
+	use();
+	restoreUniforms();
+	generation++;
+	return true;
     }
+    // every file the current program was built from, includes too
+    const std::vector<std::string> &SourceFiles() const { return files; }
+    // the macros this permutation of the sources is compiled with
+    const ShaderDefines &Defines() const { return defines; }
+    // counts the successful reloads
+    unsigned int Generation() const { return generation; }
 
   private:
+    // the source files, vertex, fragment and optionally geometry
+    std::vector<std::string> paths;
+    ShaderDefines defines;
+    // what the sources included, indexed by the source string number of
+    // the #line directives in them
+    std::vector<std::string> files;
+    // uniform blocks attached by bindUniformBlock, re-attached on reload
+    std::vector<std::pair<std::string, GLuint>> blockBindings;
+    unsigned int generation = 0;
+    // the program in the binary cache, see loadProgram
+    std::string cacheName;
+    uint64_t sourceHash = 0;
+    // set while ID is linking and nothing has asked for its status yet
+    bool pending = false;
+    std::chrono::steady_clock::time_point submitted;
+    // the stages of the program being linked, with their type for the
+    // error message, kept until the link status is known
+    std::vector<std::pair<GLuint, const char *>> stages;
+
+    // preprocesses the sources from paths, see ShaderPreprocessor. Returns
+    // false if a file can't be read.
+    bool readSources(std::string &vertexCode, std::string &fragmentCode,
+		     std::string &geometryCode)
+    {
+	ShaderPreprocessor preprocessor(defines);
+	bool ok = preprocessor.Process(paths[0], vertexCode) &&
+		  preprocessor.Process(paths[1], fragmentCode);
+	// if geometry shader path is present, also load a geometry shader
+	if (ok && hasGeometry())
+	    ok = preprocessor.Process(paths[2], geometryCode);
+	files = preprocessor.Files();
+	return ok;
+    }
+
+    bool hasGeometry() const { return paths.size() > 2; }
+
+    // links program from the binary cache, returns false on a miss. Also
+    // names the sources for submitProgram and finishProgram.
+    bool loadProgram(GLuint &program, const std::string &vertexCode,
+		     const std::string &fragmentCode,
+		     const std::string &geometryCode)
+    {
+	cacheName = paths[0];
+	for (size_t i = 1; i < paths.size(); i++)
+	    cacheName += "|" + paths[i];
+	if (!defines.empty())
+	    cacheName += "#" + ShaderDefinesKey(defines);
+	sourceHash = ProgramCache::HashSources(
+	    {vertexCode, fragmentCode, geometryCode});
+	return ProgramCache::Instance().Load(program, cacheName, sourceHash);
+    }
+
+    // compiles the sources and links them into program without waiting for
+    // either, see finishProgram
+    void submitProgram(GLuint program, const std::string &vertexCode,
+		       const std::string &fragmentCode,
+		       const std::string &geometryCode)
+    {
+	submitted = std::chrono::steady_clock::now();
+	stages.emplace_back(compileStage(GL_VERTEX_SHADER, vertexCode),
+			    "VERTEX");
+	stages.emplace_back(compileStage(GL_FRAGMENT_SHADER, fragmentCode),
+			    "FRAGMENT");
+	// if geometry shader is given, compile geometry shader
+	if (hasGeometry())
+	    stages.emplace_back(
+		compileStage(GL_GEOMETRY_SHADER, geometryCode), "GEOMETRY");
+	// shader Program
+	for (const auto &stage : stages)
+	    glAttachShader(program, stage.first);
+	ProgramCache::Instance().PrepareLink(program);
+	glLinkProgram(program);
+    }
+
+    GLuint compileStage(GLenum type, const std::string &code)
+    {
+	const char *source = code.c_str();
+	GLuint stage = glCreateShader(type);
+	glShaderSource(stage, 1, &source, NULL);
+	glCompileShader(stage);
+	return stage;
+    }
+
+    // waits for the link submitted by submitProgram, prints the logs if it
+    // failed and stores the binary if not. Returns whether program linked.
+    bool finishProgram(GLuint program)
+    {
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	// the compile logs only matter when the link failed
+	if (!linked) {
+	    for (const auto &stage : stages)
+		checkCompileErrors(stage.first, stage.second);
+	    checkCompileErrors(program, "PROGRAM");
+	}
+	// delete the shaders as they're linked into our program now and no
+	// longer necessery
+	for (const auto &stage : stages)
+	    glDeleteShader(stage.first);
+	stages.clear();
+	auto finished = std::chrono::steady_clock::now();
+	StartupTimeline::Instance().Add("compile " + programName(), submitted,
+					finished);
+	// submit to status, which overstates the compile time when other
+	// work ran in between
+	if (linked)
+	    ProgramCache::Instance().Store(
+		program, cacheName, sourceHash,
+		std::chrono::duration<double, std::micro>(finished - submitted)
+		    .count());
+	return linked == GL_TRUE;
+    }
+
+    // finishes the program the constructor submitted, on first use
+    void resolve()
+    {
+	if (!pending)
+	    return;
+	pending = false;
+	finishProgram(ID);
+	for (const auto &block : blockBindings)
+	    attachUniformBlock(block.first.c_str(), block.second);
+	reflectUniforms();
+    }
+
+    // the fragment shader's file name and defines, for messages
+    std::string programName() const
+    {
+	std::string name = paths[1].substr(paths[1].find_last_of('/') + 1);
+	if (!defines.empty())
+	    name += " " + ShaderDefinesKey(defines);
+	return name;
+    }
+
+    // active uniforms by name, filled after link. Names looked up later that
+    // the program doesn't have are added with location -1.
+    mutable std::unordered_map<std::string, UniformInfo> uniforms;
+    // "name" of each array uniform, which GL treats as "name[0]": both
+    // share the entry of "name[0]", so they share one shadow copy
+    std::unordered_map<std::string, UniformInfo *> aliases;
+
+    // builds the uniform table from the program's active uniforms. Arrays
+    // are listed by the driver as "name[0]", so "name" is aliased to it and
+    // every further element is added as well. Entries are updated in place,
+    // so after a reload handles keep pointing at them; names the new
+    // program lacks get location -1.
+    void reflectUniforms()
+    {
+	for (auto &entry : uniforms)
+	    entry.second.location = -1;
+	aliases.clear();
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::string name(maxLength > 0 ? maxLength : 1, '\0');
+	for (GLint i = 0; i < count; i++) {
+	    GLsizei length = 0;
+	    UniformInfo info;
+	    glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length,
+			       &info.size, &info.type, &name[0]);
+	    std::string uniformName(name.data(), length);
+	    info.location = glGetUniformLocation(ID, uniformName.c_str());
+	    if (info.location < 0)
+		continue; // a member of a uniform block
+	    UniformInfo &entry = uniforms[uniformName];
+	    updateUniform(entry, info);
+	    size_t bracket = uniformName.size() - 3;
+	    if (uniformName.size() > 3 &&
+		uniformName.compare(bracket, 3, "[0]") == 0) {
+		std::string base = uniformName.substr(0, bracket);
+		aliases[base] = &entry;
+		for (GLint element = 1; element < info.size; element++) {
+		    std::string elementName =
+			base + "[" + std::to_string(element) + "]";
+		    UniformInfo elementInfo = info;
+		    elementInfo.location =
+			glGetUniformLocation(ID, elementName.c_str());
+		    updateUniform(uniforms[elementName], elementInfo);
+		}
+	    }
+	}
+    }
+
+    // takes the location, type and size of info. The shadow copy is kept
+    // while the type stays the same, so restoreUniforms can upload it.
+    static void updateUniform(UniformInfo &entry, const UniformInfo &info)
+    {
+	if (entry.type != info.type || entry.size != info.size)
+	    entry.shadowSize = 0;
+	entry.location = info.location;
+	entry.type = info.type;
+	entry.size = info.size;
+    }
+    // uploads the shadowed values to the program in use
+    void restoreUniforms() const
+    {
+	for (const auto &entry : uniforms) {
+	    const UniformInfo &info = entry.second;
+	    if (info.location < 0 || info.shadowSize == 0)
+		continue;
+	    float values[16];
+	    GLint value;
+	    std::memcpy(values, info.shadow, info.shadowSize);
+	    std::memcpy(&value, info.shadow, sizeof(value));
+	    switch (info.type) {
+	    case GL_FLOAT:
+		glUniform1fv(info.location, 1, values);
+		break;
+	    case GL_FLOAT_VEC2:
+		glUniform2fv(info.location, 1, values);
+		break;
+	    case GL_FLOAT_VEC3:
+		glUniform3fv(info.location, 1, values);
+		break;
+	    case GL_FLOAT_VEC4:
+		glUniform4fv(info.location, 1, values);
+		break;
+	    case GL_FLOAT_MAT2:
+		glUniformMatrix2fv(info.location, 1, GL_FALSE, values);
+		break;
+	    case GL_FLOAT_MAT3:
+		glUniformMatrix3fv(info.location, 1, GL_FALSE, values);
+		break;
+	    case GL_FLOAT_MAT4:
+		glUniformMatrix4fv(info.location, 1, GL_FALSE, values);
+		break;
+	    default: // int, bool and sampler uniforms are set with an int
+		if (info.shadowSize == sizeof(value))
+		    glUniform1i(info.location, value);
+		break;
+	    }
+	}
+    }
+    void attachUniformBlock(const char *name, GLuint binding) const
+    {
+	GLuint index = glGetUniformBlockIndex(ID, name);
+	if (index != GL_INVALID_INDEX)
+	    glUniformBlockBinding(ID, index, binding);
+    }
+    // the entry of name once the program is linked and reflected, lookups
+    // on a pending program would all miss
+    UniformInfo &resolvedUniform(const std::string &name)
+    {
+	resolve();
+	return uniform(name);
+    }
+    UniformInfo &uniform(const std::string &name) const
+    {
+	if (!aliases.empty()) {
+	    auto alias = aliases.find(name);
+	    if (alias != aliases.end())
+		return *alias->second;
+	}
+	auto it = uniforms.find(name);
+	if (it != uniforms.end())
+	    return it->second;
+#ifndef NDEBUG
+	std::cout << "WARNING::SHADER:: program " << ID
+		  << " has no active uniform \"" << name << "\"" << std::endl;
+#endif
+	return uniforms[name];
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -179,7 +557,11 @@ class Shader
 		std::cout
 		    << "ERROR::SHADER_COMPILATION_ERROR of type: " << type
 		    << "\n"
-		    << infoLog
+		    << infoLog;
+		// the log names files by their source string number
+		for (size_t i = 0; i < files.size(); i++)
+		    std::cout << i << ": " << files[i] << "\n";
+		std::cout
 		    << "\n -- "
 		       "--------------------------------------------------- -- "
 		    << std::endl;
@@ -0,0 +1,66 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_preprocessor.h>
+#include <learnopengl/shader_watcher.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// the programs built from one vertex/fragment pair with different defines.
+// Each permutation is compiled (or linked from the program cache) the first
+// time it is asked for and kept, so toggling a feature selects a program
+// specialized for it instead of branching on a uniform in every fragment.
+class ShaderPermutations
+{
+  public:
+    // permutations are registered with watcher when it is given
+    ShaderPermutations(const char *vertexPath, const char *fragmentPath,
+		       ShaderWatcher *watcher = nullptr)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), watcher(watcher)
+    {
+    }
+
+    ShaderPermutations(const ShaderPermutations &) = delete;
+    ShaderPermutations &operator=(const ShaderPermutations &) = delete;
+
+    // the program compiled with defines. References stay valid for the
+    // lifetime of the set.
+    Shader &Get(const ShaderDefines &defines)
+    {
+	std::string key = ShaderDefinesKey(defines);
+	auto it = programs.find(key);
+	if (it != programs.end())
+	    return *it->second;
+	std::unique_ptr<Shader> shader(new Shader(
+	    vertexPath.c_str(), fragmentPath.c_str(), nullptr, defines));
+	for (const auto &block : blockBindings)
+	    shader->bindUniformBlock(block.first.c_str(), block.second);
+	if (watcher)
+	    watcher->Watch(*shader);
+	return *(programs[key] = std::move(shader));
+    }
+
+    // attaches a uniform block in every permutation, built or not yet
+    void bindUniformBlock(const char *name, GLuint binding)
+    {
+	blockBindings.emplace_back(name, binding);
+	for (auto &program : programs)
+	    program.second->bindUniformBlock(name, binding);
+    }
+
+    size_t Size() const { return programs.size(); }
+
+  private:
+    std::string vertexPath, fragmentPath;
+    ShaderWatcher *watcher;
+    std::vector<std::pair<std::string, GLuint>> blockBindings;
+    // by ShaderDefinesKey
+    std::unordered_map<std::string, std::unique_ptr<Shader>> programs;
+};
+
+#endif
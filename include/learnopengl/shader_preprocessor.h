@@ -0,0 +1,129 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// macros injected into a shader, by name. An empty value gives a plain
+// "#define NAME" for #ifdef tests. Kept sorted, so equal sets of defines
+// always produce the same key and source.
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// "NAME=VALUE;..." naming one permutation of a shader
+inline std::string ShaderDefinesKey(const ShaderDefines &defines)
+{
+    std::string key;
+    for (const auto &define : defines)
+	key += define.first + "=" + define.second + ";";
+    return key;
+}
+
+// front-end run on every shader file before it is compiled:
+//  - the defines are inserted right after the #version line;
+//  - #include "file" lines are replaced by the file, named relative to the
+//    file including it. Each file is included once per Process() call, so
+//    shared declarations need no guards and include cycles end.
+// #line directives keep compiler messages pointing at the right line; the
+// source string number in them ("2(14)" in a log) indexes Files().
+class ShaderPreprocessor
+{
+  public:
+    explicit ShaderPreprocessor(const ShaderDefines &defines)
+	: defines(defines)
+    {
+    }
+
+    // the expanded source of the file at path, false if a file is missing
+    bool Process(const std::string &path, std::string &source)
+    {
+	std::ostringstream out;
+	included.clear();
+	bool ok = expand(path, out, true);
+	source = out.str();
+	return ok;
+    }
+
+    // every file read so far, each once, the first root file first
+    const std::vector<std::string> &Files() const { return files; }
+
+  private:
+    const ShaderDefines &defines;
+    std::vector<std::string> files;
+    std::set<std::string> included;
+
+    bool expand(const std::string &path, std::ostringstream &out, bool root)
+    {
+	std::ifstream file(path);
+	if (!file) {
+	    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path
+		      << std::endl;
+	    return false;
+	}
+	included.insert(path);
+	size_t index = 0;
+	while (index < files.size() && files[index] != path)
+	    index++;
+	if (index == files.size())
+	    files.push_back(path);
+	std::string directory;
+	size_t slash = path.find_last_of('/');
+	if (slash != std::string::npos)
+	    directory = path.substr(0, slash + 1);
+
+	// GLSL 3.30: after "#line n" the next line is line n + 1
+	if (!root)
+	    out << "#line 0 " << index << "\n";
+	bool ok = true;
+	std::string line;
+	for (int number = 1; std::getline(file, line); number++) {
+	    std::string include;
+	    if (root && number == 1 && isDirective(line, "version")) {
+		out << line << "\n";
+		for (const auto &define : defines)
+		    out << "#define " << define.first << " " << define.second
+			<< "\n";
+		out << "#line 1 " << index << "\n";
+	    } else if (parseInclude(line, include)) {
+		std::string includePath = directory + include;
+		if (!included.count(includePath)) {
+		    ok = expand(includePath, out, false) && ok;
+		    out << "#line " << number << " " << index << "\n";
+		}
+	    } else {
+		out << line << "\n";
+	    }
+	}
+	return ok;
+    }
+
+    // whether line is "#name ...", allowing blanks around the '#'
+    static bool isDirective(const std::string &line, const char *name)
+    {
+	size_t start = line.find_first_not_of(" \t");
+	if (start == std::string::npos || line[start] != '#')
+	    return false;
+	start = line.find_first_not_of(" \t", start + 1);
+	return start != std::string::npos &&
+	       line.compare(start, std::string(name).size(), name) == 0;
+    }
+
+    // reads the file name out of an #include "file" line
+    static bool parseInclude(const std::string &line, std::string &include)
+    {
+	if (!isDirective(line, "include"))
+	    return false;
+	size_t open = line.find('"');
+	size_t close = line.find('"', open + 1);
+	if (open == std::string::npos || close == std::string::npos)
+	    return false;
+	include = line.substr(open + 1, close - open - 1);
+	return true;
+    }
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <learnopengl/shader.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// reloads shaders when their source files, or files they include, change. A
+// background thread blocks on inotify for the directories of the watched
+// shaders and records the files written there; Poll() is called once per
+// frame on the render thread and rebuilds the programs reading a changed
+// file. While nothing changes Poll() is a single atomic load. Watched
+// shaders must stay alive while Poll() is called.
+class ShaderWatcher
+{
+  public:
+    ShaderWatcher()
+    {
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd < 0 || pipe2(stopPipe, O_CLOEXEC) != 0) {
+	    std::cout << "WARNING::SHADER_WATCHER:: inotify unavailable, "
+			 "shaders won't reload"
+		      << std::endl;
+	    return;
+	}
+	worker = std::thread([this]() { watch(); });
+    }
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    ~ShaderWatcher()
+    {
+	if (worker.joinable()) {
+	    char stop = 1;
+	    if (write(stopPipe[1], &stop, 1) == 1)
+		worker.join();
+	    else
+		worker.detach();
+	}
+	for (int fd : {inotifyFd, stopPipe[0], stopPipe[1]})
+	    if (fd >= 0)
+		close(fd);
+    }
+
+    // render thread: reloads shader whenever one of its sources is written
+    void Watch(Shader &shader)
+    {
+	shaders.push_back(&shader);
+	addWatches(shader);
+    }
+
+    // render thread, at a frame boundary: reloads the shaders whose sources
+    // changed since the last call. Returns how many were reloaded; a shader
+    // that fails to compile keeps its previous program.
+    unsigned int Poll()
+    {
+	if (!pending.load(std::memory_order_relaxed))
+	    return 0;
+	std::unordered_set<std::string> written;
+	{
+	    std::lock_guard<std::mutex> lock(mutex);
+	    written.swap(changed);
+	    pending = false;
+	}
+	unsigned int reloaded = 0;
+	for (Shader *shader : shaders) {
+	    for (const std::string &path : shader->SourceFiles()) {
+		std::string name = path.substr(path.find_last_of('/') + 1);
+		if (!written.count(directoryOf(path) + "/" + name))
+		    continue;
+		if (shader->Reload()) {
+		    std::cout << "ShaderWatcher: reloaded " << path
+			      << std::endl;
+		    addWatches(*shader); // it may include new files
+		    reloaded++;
+		}
+		break;
+	    }
+	}
+	return reloaded;
+    }
+
+  private:
+    int inotifyFd = -1;
+    int stopPipe[2] = {-1, -1};
+    std::thread worker;
+    std::vector<Shader *> shaders; // render thread only
+
+    std::mutex mutex; // guards directories and changed
+    std::unordered_map<int, std::string> directories; // by watch descriptor
+    std::unordered_set<std::string> changed; // "directory/name" written
+    std::atomic<bool> pending{false};	     // changed is not empty
+
+    // watches the directories of every file shader is built from
+    void addWatches(const Shader &shader)
+    {
+	if (!worker.joinable())
+	    return;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const std::string &path : shader.SourceFiles()) {
+	    std::string directory = directoryOf(path);
+	    int wd = inotify_add_watch(inotifyFd, directory.c_str(),
+				       IN_CLOSE_WRITE | IN_MOVED_TO);
+	    if (wd >= 0)
+		directories[wd] = directory;
+	}
+    }
+
+    static std::string directoryOf(const std::string &path)
+    {
+	size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    // watcher thread: sleeps until inotify has events or the stop pipe is
+    // written
+    void watch()
+    {
+	pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+	for (;;) {
+	    if (poll(fds, 2, -1) < 0) {
+		if (errno == EINTR)
+		    continue;
+		return;
+	    }
+	    if (fds[1].revents)
+		return;
+	    if (fds[0].revents & POLLIN)
+		readEvents();
+	}
+    }
+
+    void readEvents()
+    {
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length;
+	while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+	    std::lock_guard<std::mutex> lock(mutex);
+	    for (char *p = buffer; p < buffer + length;) {
+		const inotify_event *event = (const inotify_event *)p;
+		p += sizeof(inotify_event) + event->len;
+		auto directory = directories.find(event->wd);
+		if (event->len == 0 || directory == directories.end())
+		    continue;
+		changed.insert(directory->second + "/" + event->name);
+	    }
+	    if (!changed.empty())
+		pending = true;
+	}
+    }
+};
+
+#endif
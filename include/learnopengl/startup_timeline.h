@@ -0,0 +1,104 @@
+#ifndef STARTUP_TIMELINE_H
+#define STARTUP_TIMELINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// wall-clock spans of the work done while the app starts, recorded from any
+// thread and printed as one chart so work that overlaps (driver compiles,
+// model import, texture decode) shows as overlapping bars. Recording stops
+// once the chart is reported.
+class StartupTimeline
+{
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    // records a span from its construction to the end of the scope
+    class Scope
+    {
+      public:
+	explicit Scope(std::string name)
+	    : name(std::move(name)), start(Clock::now())
+	{
+	}
+	~Scope() { StartupTimeline::Instance().Add(name, start, Clock::now()); }
+
+	Scope(const Scope &) = delete;
+	Scope &operator=(const Scope &) = delete;
+
+      private:
+	std::string name;
+	Clock::time_point start;
+    };
+
+    static StartupTimeline &Instance()
+    {
+	static StartupTimeline timeline;
+	return timeline;
+    }
+
+    void Add(const std::string &name, Clock::time_point start,
+	     Clock::time_point end)
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!reported)
+	    spans.push_back({name, start, end});
+    }
+
+    // one line per span in start order, times in ms from the first span
+    void Report(std::ostream &out)
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	reported = true;
+	if (spans.empty())
+	    return;
+	std::sort(spans.begin(), spans.end(),
+		  [](const Span &a, const Span &b) {
+		      return a.start < b.start;
+		  });
+	Clock::time_point origin = spans.front().start, last = origin;
+	for (const Span &span : spans)
+	    last = std::max(last, span.end);
+	double total = milliseconds(origin, last);
+	const int width = 40;
+	out << "Startup timeline, " << total << " ms:" << std::endl;
+	for (const Span &span : spans) {
+	    double from = milliseconds(origin, span.start);
+	    double to = milliseconds(origin, span.end);
+	    int begin = total > 0.0 ? (int)(from / total * width) : 0;
+	    int end = total > 0.0 ? (int)(to / total * width) : width;
+	    std::string bar(width, ' ');
+	    for (int i = begin; i < std::max(end, begin + 1) && i < width; i++)
+		bar[i] = '#';
+	    char times[32];
+	    std::snprintf(times, sizeof(times), "%8.1f %8.1f", from, to);
+	    out << "  |" << bar << "| " << times << "  " << span.name
+		<< std::endl;
+	}
+    }
+
+  private:
+    struct Span {
+	std::string name;
+	Clock::time_point start, end;
+    };
+
+    std::mutex mutex;
+    std::vector<Span> spans;
+    bool reported = false;
+
+    StartupTimeline() = default;
+
+    static double milliseconds(Clock::time_point from, Clock::time_point to)
+    {
+	return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+};
+
+#endif
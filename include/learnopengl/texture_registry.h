@@ -0,0 +1,152 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// process-wide table of GL textures, so a texture referenced by several
+// models is uploaded once. Lookups are hashed by normalized path; with content
+// dedupe enabled, byte-identical image files under different names also share
+// one texture. Textures are reference counted and deleted with their last
+// user. Lookups may come from loader threads, GL objects are only created and
+// deleted by the caller's GL thread.
+class TextureRegistry
+{
+  public:
+    struct Stats {
+	// requests served by an already resident texture
+	size_t hits = 0;
+	// requests that had to decode and upload
+	size_t misses = 0;
+	// misses by path that matched a resident texture by content
+	size_t contentHits = 0;
+	// GPU bytes not uploaded thanks to hits
+	size_t bytesSaved = 0;
+    };
+
+    static TextureRegistry &Instance()
+    {
+	static TextureRegistry registry;
+	return registry;
+    }
+
+    void SetContentDedupe(bool enabled) { contentDedupe = enabled; }
+    bool ContentDedupe() const { return contentDedupe; }
+
+    // returns the texture registered under path with a new reference, or 0
+    // (counted as a miss) if the caller has to load it.
+    unsigned int Acquire(const std::string &path)
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = byPath.find(path);
+	if (it == byPath.end()) {
+	    stats.misses++;
+	    return 0;
+	}
+	Entry &entry = entries[it->second];
+	entry.refs++;
+	stats.hits++;
+	stats.bytesSaved += entry.bytes;
+	return it->second;
+    }
+
+    // after decoding a missed path: returns a texture that became resident
+    // under path in the meantime (another loader), or one with the same
+    // content hash (registering path as an alias of it). Returns 0 if the
+    // caller has to upload.
+    unsigned int AcquireContent(const std::string &path, uint64_t contentHash)
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto p = byPath.find(path);
+	if (p != byPath.end()) {
+	    Entry &entry = entries[p->second];
+	    entry.refs++;
+	    stats.bytesSaved += entry.bytes;
+	    return p->second;
+	}
+	if (!contentDedupe || contentHash == 0)
+	    return 0;
+	auto it = byContent.find(contentHash);
+	if (it == byContent.end())
+	    return 0;
+	Entry &entry = entries[it->second];
+	entry.refs++;
+	stats.contentHits++;
+	stats.bytesSaved += entry.bytes;
+	byPath[path] = it->second;
+	return it->second;
+    }
+
+    // registers a freshly uploaded texture with one reference
+    void Add(const std::string &path, unsigned int id, uint64_t contentHash,
+	     size_t bytes)
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	Entry &entry = entries[id];
+	entry.refs = 1;
+	entry.bytes = bytes;
+	entry.contentHash = contentHash;
+	byPath[path] = id;
+	if (contentDedupe && contentHash != 0)
+	    byContent.emplace(contentHash, id);
+    }
+
+    // drops a reference, the texture is deleted with the last one
+    void Release(unsigned int id)
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(id);
+	if (it == entries.end() || --it->second.refs > 0)
+	    return;
+	for (auto p = byPath.begin(); p != byPath.end();) {
+	    if (p->second == id)
+		p = byPath.erase(p);
+	    else
+		++p;
+	}
+	auto c = byContent.find(it->second.contentHash);
+	if (c != byContent.end() && c->second == id)
+	    byContent.erase(c);
+	entries.erase(it);
+	glDeleteTextures(1, &id);
+    }
+
+    Stats GetStats() const
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+    }
+
+    void Report(std::ostream &out) const
+    {
+	std::lock_guard<std::mutex> lock(mutex);
+	out << "TextureRegistry: " << entries.size() << " textures, "
+	    << stats.hits << " hits, " << stats.misses << " misses ("
+	    << stats.contentHits << " deduplicated by content), "
+	    << stats.bytesSaved / 1024 << " KiB saved" << std::endl;
+    }
+
+  private:
+    struct Entry {
+	int refs = 0;
+	size_t bytes = 0;
+	uint64_t contentHash = 0;
+    };
+
+    TextureRegistry() = default;
+
+    mutable std::mutex mutex;
+    bool contentDedupe = true;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    std::unordered_map<unsigned int, Entry> entries;
+    Stats stats;
+};
+
+#endif
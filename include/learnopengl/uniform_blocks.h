@@ -0,0 +1,132 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstring>
+
+// C++ mirrors of the std140 uniform blocks shared by the shaders. Members are
+// padded by hand to the std140 rules (vec3 aligned to 16 bytes, a following
+// float packs into its fourth component, struct and array strides rounded up
+// to 16), and the static_asserts pin every offset to what GLSL computes.
+
+// binding points the blocks are attached to, see Shader::bindUniformBlock
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint LIGHTS_BLOCK_BINDING = 1;
+
+// passed to the lighting shader as NR_POINT_LIGHT, see lights.glsl
+const int NR_POINT_LIGHTS = 4;
+
+// layout (std140) uniform Camera
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float time; // seconds, for animation in shaders
+};
+
+static_assert(offsetof(CameraBlock, projection) == 0, "std140 mismatch");
+static_assert(offsetof(CameraBlock, view) == 64, "std140 mismatch");
+static_assert(offsetof(CameraBlock, viewPosition) == 128, "std140 mismatch");
+static_assert(offsetof(CameraBlock, time) == 140, "std140 mismatch");
+static_assert(sizeof(CameraBlock) == 144, "std140 mismatch");
+
+// struct DirLight
+struct DirLightStd140 {
+    glm::vec3 direction;
+    float pad0;
+    glm::vec3 ambient;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 specular;
+    float pad3;
+};
+
+static_assert(offsetof(DirLightStd140, ambient) == 16, "std140 mismatch");
+static_assert(offsetof(DirLightStd140, diffuse) == 32, "std140 mismatch");
+static_assert(offsetof(DirLightStd140, specular) == 48, "std140 mismatch");
+static_assert(sizeof(DirLightStd140) == 64, "std140 mismatch");
+
+// struct PointLight, constant shares a 16-byte slot with ambient
+struct PointLightStd140 {
+    glm::vec3 position;
+    float pad0;
+    glm::vec3 specular;
+    float pad1;
+    glm::vec3 diffuse;
+    float pad2;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float pad3[2];
+};
+
+static_assert(offsetof(PointLightStd140, specular) == 16, "std140 mismatch");
+static_assert(offsetof(PointLightStd140, diffuse) == 32, "std140 mismatch");
+static_assert(offsetof(PointLightStd140, ambient) == 48, "std140 mismatch");
+static_assert(offsetof(PointLightStd140, constant) == 60, "std140 mismatch");
+static_assert(offsetof(PointLightStd140, linear) == 64, "std140 mismatch");
+static_assert(offsetof(PointLightStd140, quadratic) == 68, "std140 mismatch");
+static_assert(sizeof(PointLightStd140) == 80, "std140 mismatch");
+
+// layout (std140) uniform Lights
+struct LightsBlock {
+    DirLightStd140 dirLight;
+    PointLightStd140 pointLight[NR_POINT_LIGHTS];
+};
+
+static_assert(offsetof(LightsBlock, pointLight) == 64, "std140 mismatch");
+static_assert(sizeof(LightsBlock) == 64 + 80 * NR_POINT_LIGHTS,
+	      "std140 mismatch");
+
+// a uniform buffer holding one Block, attached to a binding point. Fill data
+// and call Upload() once per frame; the buffer is only written when data
+// changed since the last upload.
+template <typename Block> class UniformBuffer
+{
+  public:
+    Block data;
+
+    explicit UniformBuffer(GLuint binding)
+	: data(), binding(binding), uploaded()
+    {
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr,
+		     GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    ~UniformBuffer() { glDeleteBuffers(1, &UBO); }
+
+    // writes data to the buffer if it is dirty, returns whether it was
+    bool Upload()
+    {
+	if (valid && std::memcmp(&data, &uploaded, sizeof(Block)) == 0)
+	    return false;
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	std::memcpy(&uploaded, &data, sizeof(Block));
+	valid = true;
+	return true;
+    }
+
+    GLuint Binding() const { return binding; }
+
+  private:
+    GLuint binding;
+    unsigned int UBO = 0;
+    Block uploaded; // what the buffer currently holds
+    bool valid = false;
+};
+
+#endif
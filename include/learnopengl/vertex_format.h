@@ -0,0 +1,142 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time vertex format descriptions. A vertex struct lists its
+// attributes once, in a constexpr Attributes() function built with
+// VERTEX_ATTRIBUTE:
+//
+//   struct QuadVertex {
+//       glm::vec3 Position;
+//       glm::vec2 TexCoords;
+//
+//       static constexpr std::array<VertexAttribute, 2> Attributes()
+//       {
+//           return {{VERTEX_ATTRIBUTE(QuadVertex, Position, 0),
+//                    VERTEX_ATTRIBUTE(QuadVertex, TexCoords, 1)}};
+//       }
+//   };
+//
+// GL size, type and normalization follow from each member's C++ type (see
+// AttributeTraits), offsets from the struct and the stride is its size, so
+// SetupVertexAttributes<QuadVertex>() needs nothing spelled out by hand.
+
+// compact attribute types, their bits are uploaded as they are.
+// Snorm1010102: xyz in [-1, 1] with 10 bits each and a 2-bit w, which a 3.3
+// context decodes to -1/3, 1/3 or 1 for -1, 0, 1, so only its sign carries
+// over (see PackSnorm1010102).
+struct Snorm1010102 {
+    uint32_t bits;
+};
+struct Half2 { // two IEEE 754 binary16 floats
+    uint16_t x, y;
+};
+struct Unorm8x4 { // four bytes mapping to [0, 1], e.g. a color
+    uint8_t x, y, z, w;
+};
+
+// how the shader receives a member of type T, one specialization per type
+// a vertex attribute can have
+template <typename T> struct AttributeTraits;
+
+template <GLint Size, GLenum Type, GLboolean Normalized>
+struct AttributeTraitsOf {
+    static constexpr GLint size = Size;
+    static constexpr GLenum type = Type;
+    static constexpr GLboolean normalized = Normalized;
+};
+
+template <>
+struct AttributeTraits<float> : AttributeTraitsOf<1, GL_FLOAT, GL_FALSE> {
+};
+template <>
+struct AttributeTraits<glm::vec2> : AttributeTraitsOf<2, GL_FLOAT, GL_FALSE> {
+};
+template <>
+struct AttributeTraits<glm::vec3> : AttributeTraitsOf<3, GL_FLOAT, GL_FALSE> {
+};
+template <>
+struct AttributeTraits<glm::vec4> : AttributeTraitsOf<4, GL_FLOAT, GL_FALSE> {
+};
+template <>
+struct AttributeTraits<Snorm1010102>
+    : AttributeTraitsOf<4, GL_INT_2_10_10_10_REV, GL_TRUE> {
+};
+template <>
+struct AttributeTraits<Half2> : AttributeTraitsOf<2, GL_HALF_FLOAT, GL_FALSE> {
+};
+template <>
+struct AttributeTraits<Unorm8x4>
+    : AttributeTraitsOf<4, GL_UNSIGNED_BYTE, GL_TRUE> {
+};
+
+// one attribute of a vertex struct; bytes is 0 for "no such attribute"
+struct VertexAttribute {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+    size_t bytes;
+};
+
+template <typename T>
+constexpr VertexAttribute MakeVertexAttribute(GLuint location, size_t offset)
+{
+    return {location,
+	    AttributeTraits<T>::size,
+	    AttributeTraits<T>::type,
+	    AttributeTraits<T>::normalized,
+	    offset,
+	    sizeof(T)};
+}
+
+// the attribute member of Vertex, read by the shader at location
+#define VERTEX_ATTRIBUTE(Vertex, member, location)                             \
+    MakeVertexAttribute<decltype(Vertex::member)>(location,                    \
+						  offsetof(Vertex, member))
+
+// the attribute of V at location, with bytes 0 if V has none there
+template <typename V>
+constexpr VertexAttribute FindVertexAttribute(GLuint location)
+{
+    // indexed loops, std::array iterators are only constexpr from C++17
+    const auto attributes = V::Attributes();
+    for (size_t i = 0; i < attributes.size(); i++)
+	if (attributes[i].location == location)
+	    return attributes[i];
+    return {location, 0, GL_FLOAT, GL_FALSE, 0, 0};
+}
+
+// bytes of all attributes of V, equal to sizeof(V) when V has no padding
+template <typename V> constexpr size_t VertexAttributeBytes()
+{
+    const auto attributes = V::Attributes();
+    size_t bytes = 0;
+    for (size_t i = 0; i < attributes.size(); i++)
+	bytes += attributes[i].bytes;
+    return bytes;
+}
+
+// points the attributes of the bound VAO at an array of V in the bound
+// GL_ARRAY_BUFFER, starting byteOffset bytes in. With a divisor the array
+// advances once per that many instances instead of once per vertex.
+template <typename V>
+void SetupVertexAttributes(size_t byteOffset = 0, GLuint divisor = 0)
+{
+    for (const VertexAttribute &attribute : V::Attributes()) {
+	glEnableVertexAttribArray(attribute.location);
+	glVertexAttribPointer(attribute.location, attribute.size,
+			      attribute.type, attribute.normalized, sizeof(V),
+			      (void *)(byteOffset + attribute.offset));
+	glVertexAttribDivisor(attribute.location, divisor);
+    }
+}
+
+#endif
@@ -2,25 +2,8 @@
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
+#include "lights.glsl"
+#include "camera.glsl"
 
 struct Material {
     sampler2D texture_diffuse1;
@@ -29,17 +12,28 @@ struct Material {
     float shininess;
 };
 
-#define NR_POINT_LIGHT 4
-
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-uniform DirLight dirLight;
-uniform PointLight pointLight[NR_POINT_LIGHT];
 uniform Material material;
 
-uniform vec3 viewPosition;
+// HAS_SPECULAR_MAP is defined for models with specular maps. Others take
+// the specular intensity from the diffuse texture, which is what their
+// unbound texture_specular1 sampled on unit 0 before the permutation
+// existed, so they keep their highlights.
+#ifdef HAS_SPECULAR_MAP
+vec3 Specular(vec3 lightSpecular, float spec)
+{
+    return lightSpecular * spec * texture(material.texture_specular1, TexCoords).xxx;
+}
+#else
+vec3 Specular(vec3 lightSpecular, float spec)
+{
+    return lightSpecular * spec * texture(material.texture_diffuse1, TexCoords).xxx;
+}
+#endif
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -55,7 +49,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 specular = Specular(light.specular, spec);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -73,7 +67,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     // combine results
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 specular = Specular(light.specular, spec);
     return (ambient + diffuse + specular);
 }
 
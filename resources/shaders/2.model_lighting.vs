@@ -2,18 +2,39 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per instance, see InstanceData
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in vec2 aInstanceBob; // phase, amplitude
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool instanced;
+// placements of multi-draw batches, five texels each (see RenderQueue)
+uniform bool batched;
+uniform samplerBuffer transforms;
+uniform int transformIndex;
+#include "camera.glsl"
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    mat4 placement = model;
+    vec2 bob = vec2(0.0); // phase, amplitude
+    if (batched) {
+        int texel = transformIndex * 5;
+        placement = mat4(texelFetch(transforms, texel),
+                         texelFetch(transforms, texel + 1),
+                         texelFetch(transforms, texel + 2),
+                         texelFetch(transforms, texel + 3));
+        bob = texelFetch(transforms, texel + 4).xy;
+    } else if (instanced) {
+        placement = aInstanceModel;
+        bob = aInstanceBob;
+    }
+    FragPos = vec3(placement * vec4(aPos, 1.0));
+    FragPos.y += bob.y * sin(time + bob.x);
     Normal = aNormal;
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
@@ -0,0 +1,7 @@
+// CameraBlock in uniform_blocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+    float time;
+};
@@ -6,27 +6,24 @@ in vec2 TexCoords;
 uniform sampler2D hdrBuffer;
 uniform sampler2D bloomBlur;
 uniform sampler2D modelMask; // texture containing the mask of the models
-uniform bool hdr;
-uniform bool bloom;
 uniform float exposure;
+// HDR and BLOOM are defined in the permutations with the effect enabled
 
 void main()
 {
     const float gamma = 2.2;
     vec3 hdrColor = texture(hdrBuffer, TexCoords).rgb;
-    vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     vec3 modelMaskColor = texture(modelMask, TexCoords).rgb;
 
-    if (bloom) {
-        hdrColor += bloomColor;
-    }
+#ifdef BLOOM
+    hdrColor += texture(bloomBlur, TexCoords).rgb;
+#endif
 
     vec3 result = vec3(0.0);
-    if (hdr)
-    {
-        result = vec3(1.0) - exp(-hdrColor * exposure);
-        result = pow(result, vec3(1.0 / gamma));
-    }
+#ifdef HDR
+    result = vec3(1.0) - exp(-hdrColor * exposure);
+    result = pow(result, vec3(1.0 / gamma));
+#endif
 
     // Apply HDR effect only to the models
     result *= modelMaskColor;
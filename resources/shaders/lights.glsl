@@ -0,0 +1,30 @@
+// LightsBlock in uniform_blocks.h
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// defined by the program to NR_POINT_LIGHTS
+#ifndef NR_POINT_LIGHT
+#define NR_POINT_LIGHT 4
+#endif
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight[NR_POINT_LIGHT];
+};
@@ -6,10 +6,20 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/async_model.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_cache.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_permutations.h>
+#include <learnopengl/shader_watcher.h>
+#include <learnopengl/startup_timeline.h>
+#include <learnopengl/uniform_blocks.h>
+#include <learnopengl/vertex_format.h>
 
 #include <iostream>
 
@@ -51,6 +61,27 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// vertices of the full-screen quad (see renderQuad) and the skybox cube
+struct QuadVertex {
+    glm::vec3 Position;
+    glm::vec2 TexCoords;
+
+    static constexpr std::array<VertexAttribute, 2> Attributes()
+    {
+	return {{VERTEX_ATTRIBUTE(QuadVertex, Position, 0),
+		 VERTEX_ATTRIBUTE(QuadVertex, TexCoords, 1)}};
+    }
+};
+
+struct SkyboxVertex {
+    glm::vec3 Position;
+
+    static constexpr std::array<VertexAttribute, 1> Attributes()
+    {
+	return {{VERTEX_ATTRIBUTE(SkyboxVertex, Position, 0)}};
+    }
+};
+
 struct PointLight {
     glm::vec3 position;
     glm::vec3 ambient;
@@ -67,6 +98,9 @@ struct ProgramState {
     bool ImGuiEnabled = false;
     Camera camera;
     bool CameraMouseMovementUpdateEnabled = true;
+    // islands as multi-draws per material instead of instanced draws per
+    // mesh, switchable to compare the submission cost
+    bool MultiDrawIslands = true;
     glm::vec3 island1Position = glm::vec3(1.0f);
     glm::vec3 island2Position = glm::vec3(1.0f);
     glm::vec3 island3Position = glm::vec3(1.0f);
@@ -109,7 +143,16 @@ void ProgramState::LoadFromFile(std::string filename)
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+void DrawImGui(ProgramState *programState, const AsyncModel *loading,
+	      const RenderQueue::Stats &queueStats);
+
+void ReportMemoryUsage(const char *when);
+
+InstanceData MakeIslandInstance(glm::vec3 position, float yawDegrees);
+
+PointLightStd140 MakePointLight(glm::vec3 position, glm::vec3 ambient,
+				glm::vec3 diffuse, glm::vec3 specular,
+				const PointLight &attenuation);
 
 int main()
 {
@@ -144,6 +187,7 @@ int main()
 	std::cout << "Failed to initialize GLAD" << std::endl;
 	return -1;
     }
+    GLExtensions::Init((GLADloadproc)glfwGetProcAddress);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading
     // model).
@@ -167,18 +211,60 @@ int main()
     // configure global opengl state
     glEnable(GL_DEPTH_TEST);
 
-    // build and compile shaders
-    Shader ourShader("resources/shaders/2.model_lighting.vs",
-		     "resources/shaders/2.model_lighting.fs");
+    // edited shader sources are rebuilt between frames
+    ShaderWatcher shaderWatcher;
+
+    // build and compile shaders, all submitted up front and finished on first
+    // use. The lighting and hdr programs come in permutations specialized by
+    // defines; the lighting one is chosen again once the islands show
+    // whether they have specular maps.
+    ShaderPermutations lightingShaders("resources/shaders/2.model_lighting.vs",
+				       "resources/shaders/2.model_lighting.fs",
+				       &shaderWatcher);
+    ShaderDefines lightingDefines = {
+	{"NR_POINT_LIGHT", std::to_string(NR_POINT_LIGHTS)},
+	{"HAS_SPECULAR_MAP", ""}};
+    Shader *ourShader = &lightingShaders.Get(lightingDefines);
+    // compiled alongside, in case the islands have no specular maps
+    lightingShaders.Get({{"NR_POINT_LIGHT", std::to_string(NR_POINT_LIGHTS)}});
 
     Shader skyboxShader("resources/shaders/skybox.vs",
 			"resources/shaders/skybox.fs");
 
-    Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
+    // every hdr/bloom combination, so toggling them only switches programs
+    ShaderPermutations hdrShaders("resources/shaders/hdr.vs",
+				  "resources/shaders/hdr.fs", &shaderWatcher);
+    Shader *hdrPrograms[2][2];
+    for (int hdrOn = 0; hdrOn < 2; hdrOn++) {
+	for (int bloomOn = 0; bloomOn < 2; bloomOn++) {
+	    ShaderDefines defines;
+	    if (hdrOn)
+		defines["HDR"] = "";
+	    if (bloomOn)
+		defines["BLOOM"] = "";
+	    hdrPrograms[hdrOn][bloomOn] = &hdrShaders.Get(defines);
+	}
+    }
 
     Shader bloomShader("resources/shaders/bloom.vs",
 		       "resources/shaders/bloom.fs");
 
+    shaderWatcher.Watch(skyboxShader);
+    shaderWatcher.Watch(bloomShader);
+
+    // camera and lights are shared by all programs through uniform blocks,
+    // uploaded once per frame
+    auto cameraBlock =
+	std::make_unique<UniformBuffer<CameraBlock>>(CAMERA_BLOCK_BINDING);
+    auto lightsBlock =
+	std::make_unique<UniformBuffer<LightsBlock>>(LIGHTS_BLOCK_BINDING);
+    lightingShaders.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    lightingShaders.bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+    skyboxShader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+
+    // uniforms set every frame, resolved once
+    Uniform<int> bloomHorizontal = bloomShader.GetUniform<int>("horizontal");
+
     unsigned int hdrFBO;
     glGenFramebuffers(1, &hdrFBO);
     glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
@@ -234,13 +320,15 @@ int main()
 	    std::cout << "Framebuffer not complete!" << std::endl;
     }
 
-    // load models
-    Model island1("resources/objects/island/untitled.obj");
-    island1.SetShaderTextureNamePrefix("material.");
-    Model island2("resources/objects/island/untitled.obj");
-    island2.SetShaderTextureNamePrefix("material.");
-    Model island3("resources/objects/island/untitled.obj");
-    island3.SetShaderTextureNamePrefix("material.");
+    // island placements, scaled down since the model is a bit too big for
+    // our scene
+    vector<InstanceData> islandInstances;
+    islandInstances.push_back(
+	MakeIslandInstance(glm::vec3(0.00f, 17.00f, -40.00f), -55.0f));
+    islandInstances.push_back(
+	MakeIslandInstance(glm::vec3(20.0f, 17.00f, -0.00f), -130.0f));
+    islandInstances.push_back(
+	MakeIslandInstance(glm::vec3(-40.0f, 17.00f, -20.00f), 20.0f));
 
     PointLight &pointLight = programState->pointLight;
     pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
@@ -252,25 +340,48 @@ int main()
     pointLight.linear = 0.02f;
     pointLight.quadratic = 0.032f;
 
-    float skyboxVertices[] = {
-	// aPos
-	-1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,	 -1.0f, -1.0f,
-	1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,	-1.0f,
-
-	-1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,	-1.0f,
-	-1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,
-
-	1.0f,  -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,	 1.0f,	1.0f,
-	1.0f,  1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,	 -1.0f, -1.0f,
-
-	-1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,  1.0f,	 1.0f,	1.0f,
-	1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f,
-
-	-1.0f, 1.0f,  -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f,	 1.0f,	1.0f,
-	1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f,	-1.0f,
-
-	-1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,	 -1.0f, -1.0f,
-	1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,	 -1.0f, 1.0f};
+    const SkyboxVertex skyboxVertices[] = {
+	{{-1.0f, 1.0f, -1.0f}},
+	{{-1.0f, -1.0f, -1.0f}},
+	{{1.0f, -1.0f, -1.0f}},
+	{{1.0f, -1.0f, -1.0f}},
+	{{1.0f, 1.0f, -1.0f}},
+	{{-1.0f, 1.0f, -1.0f}},
+
+	{{-1.0f, -1.0f, 1.0f}},
+	{{-1.0f, -1.0f, -1.0f}},
+	{{-1.0f, 1.0f, -1.0f}},
+	{{-1.0f, 1.0f, -1.0f}},
+	{{-1.0f, 1.0f, 1.0f}},
+	{{-1.0f, -1.0f, 1.0f}},
+
+	{{1.0f, -1.0f, -1.0f}},
+	{{1.0f, -1.0f, 1.0f}},
+	{{1.0f, 1.0f, 1.0f}},
+	{{1.0f, 1.0f, 1.0f}},
+	{{1.0f, 1.0f, -1.0f}},
+	{{1.0f, -1.0f, -1.0f}},
+
+	{{-1.0f, -1.0f, 1.0f}},
+	{{-1.0f, 1.0f, 1.0f}},
+	{{1.0f, 1.0f, 1.0f}},
+	{{1.0f, 1.0f, 1.0f}},
+	{{1.0f, -1.0f, 1.0f}},
+	{{-1.0f, -1.0f, 1.0f}},
+
+	{{-1.0f, 1.0f, -1.0f}},
+	{{1.0f, 1.0f, -1.0f}},
+	{{1.0f, 1.0f, 1.0f}},
+	{{1.0f, 1.0f, 1.0f}},
+	{{-1.0f, 1.0f, 1.0f}},
+	{{-1.0f, 1.0f, -1.0f}},
+
+	{{-1.0f, -1.0f, -1.0f}},
+	{{-1.0f, -1.0f, 1.0f}},
+	{{1.0f, -1.0f, -1.0f}},
+	{{1.0f, -1.0f, -1.0f}},
+	{{-1.0f, -1.0f, 1.0f}},
+	{{1.0f, -1.0f, 1.0f}}};
 
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
@@ -279,9 +390,7 @@ int main()
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices,
 		 GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
-			  (void *)nullptr);
+    SetupVertexAttributes<SkyboxVertex>();
 
     vector<std::string> faces{
 	FileSystem::getPath("resources/textures/skybox/front.jpg"),
@@ -292,10 +401,35 @@ int main()
 	FileSystem::getPath("resources/textures/skybox/right.jpg")};
     stbi_set_flip_vertically_on_load(true);
 
-    unsigned int cubemapTexture = loadCubemap(faces);
+    unsigned int cubemapTexture;
+    {
+	StartupTimeline::Scope timing("skybox");
+	cubemapTexture = loadCubemap(faces);
+    }
 
-    // configure shaders
-    ourShader.use();
+    // load models in the background, all three islands share one imported
+    // model and are drawn once it has streamed in
+    ModelCache modelCache;
+    ModelOptions islandOptions;
+    islandOptions.vertexFormat = VertexFormat::Packed;
+    islandOptions.storage = MeshStorage::Shared;
+    // nothing reads the island geometry on the CPU once it is uploaded
+    islandOptions.geometry = GeometryRetention::None;
+    // upload only the vertex attributes the island shader reads, the
+    // per-instance ones come from the instance buffer. This is the first
+    // use of the lighting program, the other programs keep compiling while
+    // the islands are imported.
+    islandOptions.attributes =
+	ourShader->ActiveAttributes() & VERTEX_ALL_ATTRIBUTES;
+    shared_ptr<AsyncModel> islandLoader = modelCache.LoadAsync(
+	"resources/objects/island/untitled.obj", false, islandOptions);
+    shared_ptr<Model> island;
+
+    // configure shaders. The shininess never changes, it is set once per
+    // lighting program used rather than every frame.
+    const float materialShininess = 32.0f;
+    ourShader->use();
+    ourShader->setFloat("material.shininess", materialShininess);
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
@@ -303,11 +437,41 @@ int main()
     bloomShader.use();
     bloomShader.setInt("image", 0);
 
-    hdrShader.use();
-    hdrShader.setInt("hdrBuffer", 0);
-    hdrShader.setInt("bloomBlur", 1);
+    // the exposure is set every frame, resolved here rather than with the
+    // other handles so the hdr programs keep compiling until now. Only the
+    // permutations with an effect have its uniforms, the handles of the
+    // others stay empty and do nothing.
+    Uniform<float> hdrExposure[2][2];
+    for (int hdrOn = 0; hdrOn < 2; hdrOn++) {
+	for (int bloomOn = 0; bloomOn < 2; bloomOn++) {
+	    Shader *hdrShader = hdrPrograms[hdrOn][bloomOn];
+	    hdrShader->use();
+	    hdrShader->setInt("hdrBuffer", 0);
+	    if (bloomOn)
+		hdrShader->setInt("bloomBlur", 1);
+	    if (hdrOn)
+		hdrExposure[hdrOn][bloomOn] =
+		    hdrShader->GetUniform<float>("exposure");
+	}
+    }
+
+    // fixed-function state of each pass
+    const PipelineState scenePipeline = PipelineState().Cull(GL_BACK);
+    const PipelineState skyboxPipeline =
+	PipelineState().DepthTest(true, GL_LEQUAL);
+    const PipelineState postPipeline = PipelineState().DepthTest(false);
+
+    // the setup above bound objects directly
+    GLState &glState = GLState::Instance();
+    glState.Invalidate();
+
+    // collects the scene's draws each frame and submits them sorted. Owns
+    // GL objects, released with the others before the context goes away.
+    auto renderQueue = std::make_unique<RenderQueue>();
 
     while (!glfwWindowShouldClose(window)) {
+	shaderWatcher.Poll();
+
 	// per-frame time logic
 	float currentFrame = glfwGetTime();
 	deltaTime = currentFrame - lastFrame;
@@ -321,131 +485,113 @@ int main()
 		     programState->clearColor.b, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	// finish uploading the islands a few meshes per frame
+	if (islandLoader && islandLoader->Update()) {
+	    island = islandLoader->Get();
+	    island->SetShaderTextureNamePrefix("material.");
+	    if (!island->HasTextureType("texture_specular")) {
+		lightingDefines.erase("HAS_SPECULAR_MAP");
+		ourShader = &lightingShaders.Get(lightingDefines);
+	    }
+	    island->Bake(*ourShader);
+	    // Bake left it in use, it may be the other permutation
+	    ourShader->setFloat("material.shininess", materialShininess);
+	    TextureRegistry::Instance().Report(std::cout);
+	    island->ReportVertexFormat(std::cout);
+	    ReportMemoryUsage("islands loaded");
+	    ProgramCache::Instance().Report(std::cout);
+	    std::cout << "parallel shader compile: "
+		      << (GLExtensions::ParallelShaderCompile() ? "on" : "off")
+		      << std::endl;
+	    StartupTimeline::Instance().Report(std::cout);
+	    islandLoader.reset();
+	}
+
 	// don't forget to enable shader before setting uniforms
-	ourShader.use();
+	ourShader->use();
 
-	glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+	glState.BindFramebuffer(hdrFBO);
+	glState.Apply(scenePipeline);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// Directional Lignt
-	ourShader.setVec3("dirLight.direction", -6.6f, -25.0f, -6.6f);
-	ourShader.setVec3("dirLight.ambient", 0.06, 0.06, 0.06);
-	ourShader.setVec3("dirLight.diffuse", 0.6f, 0.2f, 0.2);
-	ourShader.setVec3("dirLight.specular", 0.1, 0.1, 0.1);
+	LightsBlock &lights = lightsBlock->data;
+	lights.dirLight.direction = glm::vec3(-6.6f, -25.0f, -6.6f);
+	lights.dirLight.ambient = glm::vec3(0.06, 0.06, 0.06);
+	lights.dirLight.diffuse = glm::vec3(0.6f, 0.2f, 0.2);
+	lights.dirLight.specular = glm::vec3(0.1, 0.1, 0.1);
 
 	// Pointlights
-	ourShader.setVec3("pointLight[0].position",
-			  glm::vec3(0.00f, 25, -40.00f));
-	ourShader.setVec3("pointLight[0].ambient", glm::vec3(0.02, 0.02, 0.02));
-	ourShader.setVec3("pointLight[0].diffuse",
-			  glm::vec3(0.02, 0.02f, 0.02f));
-	ourShader.setVec3("pointLight[0].specular",
-			  glm::vec3(0.22, 0.22, 0.22)); // moze malo, fazon 0.22
-	ourShader.setFloat("pointLight[0].constant", pointLight.constant);
-	ourShader.setFloat("pointLight[0].linear", pointLight.linear);
-	ourShader.setFloat("pointLight[0].quadratic", pointLight.quadratic);
-
-	ourShader.setVec3("pointLight[1].position",
-			  glm::vec3(30, 30 + 2 * sin(glfwGetTime() * 2), -1));
-	ourShader.setVec3("pointLight[1].ambient",
-			  glm::vec3(0.003, 0.003, 0.003));
-	ourShader.setVec3("pointLight[1].diffuse", glm::vec3(1.55, 1.55, 1.56));
-	ourShader.setVec3("pointLight[1].specular",
-			  glm::vec3(1.12, 1.12, 1.12));
-	ourShader.setFloat("pointLight[1].constant", pointLight.constant);
-	ourShader.setFloat("pointLight[1].linear", pointLight.linear);
-	ourShader.setFloat("pointLight[1].quadratic", pointLight.quadratic);
-
-	ourShader.setVec3("pointLight[2].position", glm::vec3(-40, 25, -20));
-	ourShader.setVec3("pointLight[2].ambient", glm::vec3(0.04, 0.04, 0.04));
-	ourShader.setVec3("pointLight[2].diffuse", glm::vec3(0.2, 0.2, 0.2));
-	ourShader.setVec3("pointLight[2].specular",
-			  glm::vec3(0.22, 0.22, 0.22));
-	ourShader.setFloat("pointLight[2].constant", pointLight.constant);
-	ourShader.setFloat("pointLight[2].linear", pointLight.linear);
-	ourShader.setFloat("pointLight[2].quadratic", pointLight.quadratic);
-
-	ourShader.setVec3("pointLight[3].position",
-			  glm::vec3(0.00f, 25, -40.00f));
-	ourShader.setVec3("pointLight[3].ambient", glm::vec3(0.04, 0.04, 0.04));
-	ourShader.setVec3("pointLight[3].diffuse", glm::vec3(0.2, 0.2f, 0.2f));
-	ourShader.setVec3("pointLight[3].specular",
-			  glm::vec3(0.22, 0.22, 0.22));
-	ourShader.setFloat("pointLight[3].constant", pointLight.constant);
-	ourShader.setFloat("pointLight[3].linear", pointLight.linear);
-	ourShader.setFloat("pointLight[3].quadratic", pointLight.quadratic);
-
-	ourShader.setVec3("viewPosition", programState->camera.Position);
-	ourShader.setFloat("material.shininess", 32.0f);
+	lights.pointLight[0] =
+	    MakePointLight(glm::vec3(0.00f, 25, -40.00f),
+			   glm::vec3(0.02, 0.02, 0.02),
+			   glm::vec3(0.02, 0.02f, 0.02f),
+			   glm::vec3(0.22, 0.22, 0.22), // moze malo, fazon 0.22
+			   pointLight);
+	lights.pointLight[1] = MakePointLight(
+	    glm::vec3(30, 30 + 2 * sin(glfwGetTime() * 2), -1),
+	    glm::vec3(0.003, 0.003, 0.003), glm::vec3(1.55, 1.55, 1.56),
+	    glm::vec3(1.12, 1.12, 1.12), pointLight);
+	lights.pointLight[2] = MakePointLight(
+	    glm::vec3(-40, 25, -20), glm::vec3(0.04, 0.04, 0.04),
+	    glm::vec3(0.2, 0.2, 0.2), glm::vec3(0.22, 0.22, 0.22), pointLight);
+	lights.pointLight[3] = MakePointLight(
+	    glm::vec3(0.00f, 25, -40.00f), glm::vec3(0.04, 0.04, 0.04),
+	    glm::vec3(0.2, 0.2f, 0.2f), glm::vec3(0.22, 0.22, 0.22),
+	    pointLight);
+	lightsBlock->Upload();
 
 	// view/projection transformations
-	glm::mat4 projection = glm::perspective(
+	CameraBlock &camera = cameraBlock->data;
+	camera.projection = glm::perspective(
 	    glm::radians(programState->camera.Zoom),
 	    (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	glm::mat4 view = programState->camera.GetViewMatrix();
-	ourShader.setMat4("projection", projection);
-	ourShader.setMat4("view", view);
-
-	glm::mat4 model = glm::mat4(1.0f);
-	model = glm::translate(
-	    model, glm::vec3(0.00f, 17.00f + 2 * sin(glfwGetTime()), -40.00f));
-	model = glm::scale(
-	    model,
-	    glm::vec3(
-		0.02, 0.02,
-		0.02)); // it's a bit too big for our scene, so scale it down
-	model = glm::rotate(model, glm::radians(-55.0f),
-			    glm::vec3(0.0f, 1.0f, 0.0f));
-	ourShader.setMat4("model", model);
-	island1.Draw(ourShader);
-
-	model = glm::mat4(1.0f);
-	model = glm::translate(
-	    model, glm::vec3(20.0f, 17.00f + 2 * sin(glfwGetTime()), -0.00f));
-	model = glm::scale(model, glm::vec3(0.02, 0.02, 0.02));
-	model = glm::rotate(model, glm::radians(-130.0f),
-			    glm::vec3(0.0f, 1.0f, 0.0f));
-	ourShader.setMat4("model", model);
-	island2.Draw(ourShader);
-
-	model = glm::mat4(1.0f);
-	model = glm::translate(
-	    model, glm::vec3(-40.0f, 17.00f + 2 * sin(glfwGetTime()), -20.00f));
-	model = glm::scale(model, glm::vec3(0.02, 0.02, 0.02));
-	model = glm::rotate(model, glm::radians(20.0f),
-			    glm::vec3(0.0f, 1.0f, 0.0f));
-	ourShader.setMat4("model", model);
-	island3.Draw(ourShader);
-
-	// skybox always goes last
-	glDepthFunc(GL_LEQUAL);
-	skyboxShader.use();
-	model = glm::mat4(1.0f);
-	projection = glm::perspective(glm::radians(programState->camera.Zoom),
-				      (float)SCR_WIDTH / (float)SCR_HEIGHT,
-				      0.1f, 100.0f);
-	view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-	skyboxShader.setMat4("view", view);
-	skyboxShader.setMat4("projection", projection);
-
-	// skybox cube
-	glBindVertexArray(skyboxVAO);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
-	glDepthFunc(GL_LESS); // depth function back to normal state.
+	camera.view = programState->camera.GetViewMatrix();
+	camera.viewPosition = programState->camera.Position;
+	camera.time = (float)glfwGetTime();
+	cameraBlock->Upload();
+
+	// models and meshes outside the view are dropped before they are
+	// queued
+	renderQueue->Begin(programState->camera.Position,
+			  programState->camera.GetFrustum(camera.projection));
+
+	// the islands bob in the shader. Either a multi-draw per material and
+	// island, or one instanced draw per mesh for all islands.
+	if (island && programState->MultiDrawIslands)
+	    island->SubmitBatched(*renderQueue, *ourShader, scenePipeline,
+				  islandInstances);
+	else if (island)
+	    island->Submit(*renderQueue, *ourShader, scenePipeline,
+			   islandInstances);
+
+	// the skybox reads the camera block and drops the translation itself
+	RenderCommand skybox;
+	skybox.pass = RenderPass::Sky;
+	skybox.pipeline = &skyboxPipeline;
+	skybox.shader = &skyboxShader;
+	skybox.vao = skyboxVAO;
+	skybox.textureTarget = GL_TEXTURE_CUBE_MAP;
+	skybox.texture = cubemapTexture;
+	skybox.vertexCount = 36;
+	renderQueue->Submit(skybox);
+
+	// sorted by pass, program, textures and depth, so the skybox still
+	// goes last
+	renderQueue->Flush();
 
 	// loading pingpong
 	bool horizontal = true, first_iteration = true;
 	unsigned int amount = 10;
+	glState.Apply(postPipeline);
 	bloomShader.use();
 	for (unsigned int i = 0; i < amount; i++) {
-	    glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-	    bloomShader.setInt("horizontal", horizontal);
-	    glBindTexture(GL_TEXTURE_2D,
-			  first_iteration ? colorBuffers[1]
-					  : pingpongColorbuffers[!horizontal]);
+	    glState.BindFramebuffer(pingpongFBO[horizontal]);
+	    bloomHorizontal.Set(horizontal);
+	    glState.BindTexture(0, GL_TEXTURE_2D,
+				first_iteration
+				    ? colorBuffers[1]
+				    : pingpongColorbuffers[!horizontal]);
 
 	    renderQuad();
 
@@ -453,22 +599,25 @@ int main()
 	    if (first_iteration)
 		first_iteration = false;
 	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glState.BindFramebuffer(0);
 
 	// hdr/bloom
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	Shader &hdrShader = *hdrPrograms[hdr][bloom];
 	hdrShader.use();
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-	hdrShader.setBool("hdr", hdr);
-	hdrShader.setBool("bloom", bloom);
-	hdrShader.setFloat("exposure", exposure);
+	glState.BindTexture(0, GL_TEXTURE_2D, colorBuffers[0]);
+	glState.BindTexture(1, GL_TEXTURE_2D,
+			    pingpongColorbuffers[!horizontal]);
+	hdrExposure[hdr][bloom].Set(exposure);
 	renderQuad();
 
-	if (programState->ImGuiEnabled)
-	    DrawImGui(programState);
+	if (programState->ImGuiEnabled || islandLoader) {
+	    DrawImGui(programState, islandLoader.get(),
+		      renderQueue->LastFlush());
+	    // ImGui sets its own state
+	    glState.Invalidate();
+	}
+	glState.EndFrame();
 
 	// glfw: swap buffers and poll IO events (keys pressed/released, mouse
 	// moved etc.)
@@ -476,6 +625,15 @@ int main()
 	glfwPollEvents();
     }
 
+    ReportMemoryUsage("exit");
+    // the models and buffers free their GL objects, so release them while
+    // the context is still alive
+    islandLoader.reset();
+    island.reset();
+    cameraBlock.reset();
+    lightsBlock.reset();
+    renderQueue.reset();
+
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
@@ -491,10 +649,12 @@ unsigned int quadVBO;
 void renderQuad()
 {
     if (quadVAO == 0) {
-	float quadVertices[] = {
-	    // positions        // texture Coords
-	    -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-	    1.0f,  1.0f, 0.0f, 1.0f, 1.0f, 1.0f,  -1.0f, 0.0f, 1.0f, 0.0f,
+	const QuadVertex quadVertices[] = {
+	    // positions           // texture Coords
+	    {{-1.0f, 1.0f, 0.0f}, {0.0f, 1.0f}},
+	    {{-1.0f, -1.0f, 0.0f}, {0.0f, 0.0f}},
+	    {{1.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
+	    {{1.0f, -1.0f, 0.0f}, {1.0f, 0.0f}},
 	};
 	// setup plane VAO
 	glGenVertexArrays(1, &quadVAO);
@@ -503,16 +663,10 @@ void renderQuad()
 	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
 		     GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-			      (void *)nullptr);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-			      (void *)(3 * sizeof(float)));
+	SetupVertexAttributes<QuadVertex>();
     }
-    glBindVertexArray(quadVAO);
+    GLState::Instance().BindVertexArray(quadVAO);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this
@@ -593,12 +747,29 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState)
+void DrawImGui(ProgramState *programState, const AsyncModel *loading,
+	      const RenderQueue::Stats &queueStats)
 {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    if (loading) {
+	ImGui::SetNextWindowPos(ImVec2(10, 10));
+	ImGui::Begin("Loading", nullptr,
+		     ImGuiWindowFlags_NoDecoration |
+			 ImGuiWindowFlags_AlwaysAutoResize);
+	ImGui::Text("Loading islands...");
+	ImGui::ProgressBar(loading->Progress(), ImVec2(200, 0));
+	ImGui::End();
+    }
+
+    if (!programState->ImGuiEnabled) {
+	ImGui::Render();
+	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	return;
+    }
+
     {
 	static float f = 0.0f;
 	ImGui::Begin("Hello window");
@@ -630,6 +801,20 @@ void DrawImGui(ProgramState *programState)
 		    c.Front.z);
 	ImGui::Checkbox("Camera mouse update",
 			&programState->CameraMouseMovementUpdateEnabled);
+	const GLState::Counters &calls = GLState::Instance().LastFrame();
+	ImGui::Text("GL state calls: %u issued, %u elided", calls.issued,
+		    calls.elided);
+	ImGui::Text("Render queue: %u draws, %d state changes sorted away",
+		    queueStats.commands, queueStats.ChangesRemoved());
+	ImGui::Text("Render queue: %u GL draw calls, %.1f us CPU submission",
+		    queueStats.drawCalls, queueStats.cpuMicroseconds);
+	const RenderQueue::Stats::Culling &culling = queueStats.culling;
+	ImGui::Text("Culling: %u/%u islands, %u/%u meshes visible",
+		    culling.modelsVisible,
+		    culling.modelsVisible + culling.modelsCulled,
+		    culling.meshesVisible,
+		    culling.meshesVisible + culling.meshesCulled);
+	ImGui::Checkbox("Multi-draw islands", &programState->MultiDrawIslands);
 	ImGui::End();
     }
 
@@ -678,4 +863,45 @@ unsigned int loadCubemap(vector<std::string> faces)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
     return textureID;
-}
\ No newline at end of file
+}
+
+// prints current and peak resident memory, see readMemoryUsage
+void ReportMemoryUsage(const char *when)
+{
+    MemoryUsage usage = readMemoryUsage();
+    std::cout << "Memory (" << when << "): " << usage.residentKiB
+	      << " KiB resident, " << usage.peakResidentKiB << " KiB peak"
+	      << std::endl;
+}
+
+// a point light of the Lights block, attenuation comes from the light edited
+// in ImGui
+PointLightStd140 MakePointLight(glm::vec3 position, glm::vec3 ambient,
+				glm::vec3 diffuse, glm::vec3 specular,
+				const PointLight &attenuation)
+{
+    PointLightStd140 light = {};
+    light.position = position;
+    light.ambient = ambient;
+    light.diffuse = diffuse;
+    light.specular = specular;
+    light.constant = attenuation.constant;
+    light.linear = attenuation.linear;
+    light.quadratic = attenuation.quadratic;
+    return light;
+}
+
+// an island at position, turned by yawDegrees, bobbing 2 units up and down
+InstanceData MakeIslandInstance(glm::vec3 position, float yawDegrees)
+{
+    InstanceData instance;
+    instance.transform = glm::translate(glm::mat4(1.0f), position);
+    instance.transform =
+	glm::scale(instance.transform, glm::vec3(0.02f, 0.02f, 0.02f));
+    instance.transform =
+	glm::rotate(instance.transform, glm::radians(yawDegrees),
+		    glm::vec3(0.0f, 1.0f, 0.0f));
+    instance.bobPhase = 0.0f;
+    instance.bobAmplitude = 2.0f;
+    return instance;
+}
@@ -0,0 +1,68 @@
+// Reports cold (ASSIMP import) vs warm (mesh cache) load time of a model.
+// usage: mesh_cache_bench [model path] [runs]
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+static double loadMilliseconds(const std::string &path)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+	Model model(path);
+	glFinish();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    std::string path =
+	argc > 1 ? argv[1]
+		 : FileSystem::getPath("resources/objects/island/untitled.obj");
+    int runs = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    // the buffers and textures need a context, but nothing is presented
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "bench", nullptr, nullptr);
+    if (window == nullptr) {
+	std::cout << "Failed to create GLFW window" << std::endl;
+	glfwTerminate();
+	return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+	std::cout << "Failed to initialize GLAD" << std::endl;
+	return -1;
+    }
+    GLExtensions::Init((GLADloadproc)glfwGetProcAddress);
+    stbi_set_flip_vertically_on_load(true);
+
+    double cold = 0.0, warm = 0.0;
+    for (int i = 0; i < runs; i++) {
+	std::remove(
+	    MeshCache::PathFor(path, Model::ImportFlags(ModelOptions()))
+		.c_str());
+	cold += loadMilliseconds(path);
+	warm += loadMilliseconds(path);
+    }
+    std::printf("%s\n  cold (assimp): %8.2f ms\n  warm (cache):  %8.2f ms\n"
+		"  speedup:       %8.2fx\n",
+		path.c_str(), cold / runs, warm / runs, cold / warm);
+
+    glfwTerminate();
+    return 0;
+}
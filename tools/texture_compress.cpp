@@ -0,0 +1,385 @@
+// Converts PNG/JPEG textures into block-compressed DDS files with a full mip
+// chain, which UploadTexture then uploads as-is instead of decoding with stb
+// and calling glGenerateMipmap. The output is written next to each input
+// with ".dds" appended, e.g. "wood.png.dds", so inputs differing only in
+// extension don't share an output. The loader ignores a DDS file older than
+// its input, so rerun the tool after editing a texture.
+//
+// usage: texture_compress [--bc1|--bc3|--bc4|--bc5] <image>...
+// Without a format flag it is picked per image: 1 channel -> BC4,
+// 3 or opaque 4 -> BC1, 2 or 4 with alpha -> BC3. --bc5 keeps only red and
+// green, for normal maps.
+#include <learnopengl/dds.h>
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class BlockFormat { Auto, BC1, BC3, BC4, BC5 };
+
+// an RGBA8 image, rows bottom to top like stb hands them to GL
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba;
+
+    const uint8_t *Pixel(int x, int y) const
+    {
+	x = std::min(x, width - 1);
+	y = std::min(y, height - 1);
+	return &rgba[((size_t)y * width + x) * 4];
+    }
+};
+
+static Image Downsample(const Image &src)
+{
+    Image dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.rgba.resize((size_t)dst.width * dst.height * 4);
+    for (int y = 0; y < dst.height; y++) {
+	for (int x = 0; x < dst.width; x++) {
+	    const uint8_t *a = src.Pixel(2 * x, 2 * y);
+	    const uint8_t *b = src.Pixel(2 * x + 1, 2 * y);
+	    const uint8_t *c = src.Pixel(2 * x, 2 * y + 1);
+	    const uint8_t *d = src.Pixel(2 * x + 1, 2 * y + 1);
+	    uint8_t *out = &dst.rgba[((size_t)y * dst.width + x) * 4];
+	    for (int ch = 0; ch < 4; ch++)
+		out[ch] = (uint8_t)((a[ch] + b[ch] + c[ch] + d[ch] + 2) / 4);
+	}
+    }
+    return dst;
+}
+
+static uint16_t To565(const float color[3])
+{
+    int r = (int)std::lround(std::min(std::max(color[0], 0.0f), 255.0f) *
+			     31.0f / 255.0f);
+    int g = (int)std::lround(std::min(std::max(color[1], 0.0f), 255.0f) *
+			     63.0f / 255.0f);
+    int b = (int)std::lround(std::min(std::max(color[2], 0.0f), 255.0f) *
+			     31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void From565(uint16_t c, int out[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+static void Put16(uint8_t *out, uint16_t v)
+{
+    out[0] = (uint8_t)(v & 0xff);
+    out[1] = (uint8_t)(v >> 8);
+}
+
+// BC1 color block: endpoints along the principal axis of the block's colors,
+// pulled in slightly to reduce the error of the interpolated entries.
+static void EncodeColorBlock(const uint8_t block[16][4], uint8_t out[8])
+{
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+	for (int c = 0; c < 3; c++)
+	    mean[c] += block[i][c] / 16.0f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+	float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1],
+		      block[i][2] - mean[2]};
+	cov[0] += d[0] * d[0];
+	cov[1] += d[0] * d[1];
+	cov[2] += d[0] * d[2];
+	cov[3] += d[1] * d[1];
+	cov[4] += d[1] * d[2];
+	cov[5] += d[2] * d[2];
+    }
+    // power iteration for the dominant eigenvector
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iter = 0; iter < 8; iter++) {
+	float next[3] = {
+	    cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+	    cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+	    cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+	float length = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+				 next[2] * next[2]);
+	if (length < 1e-6f)
+	    break;
+	for (int c = 0; c < 3; c++)
+	    axis[c] = next[c] / length;
+    }
+
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; i++) {
+	float t = 0;
+	for (int c = 0; c < 3; c++)
+	    t += (block[i][c] - mean[c]) * axis[c];
+	minT = std::min(minT, t);
+	maxT = std::max(maxT, t);
+    }
+    float inset = (maxT - minT) / 16.0f;
+    minT += inset;
+    maxT -= inset;
+    float hi[3], lo[3];
+    for (int c = 0; c < 3; c++) {
+	hi[c] = mean[c] + axis[c] * maxT;
+	lo[c] = mean[c] + axis[c] * minT;
+    }
+
+    uint16_t c0 = To565(hi), c1 = To565(lo);
+    if (c0 < c1)
+	std::swap(c0, c1);
+    Put16(out, c0);
+    Put16(out + 2, c1);
+    uint32_t indices = 0;
+    if (c0 != c1) {
+	int palette[4][3];
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+	    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+	    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+	for (int i = 0; i < 16; i++) {
+	    int best = 0, bestError = 1 << 30;
+	    for (int p = 0; p < 4; p++) {
+		int error = 0;
+		for (int c = 0; c < 3; c++) {
+		    int d = block[i][c] - palette[p][c];
+		    error += d * d;
+		}
+		if (error < bestError) {
+		    bestError = error;
+		    best = p;
+		}
+	    }
+	    indices |= (uint32_t)best << (2 * i);
+	}
+    }
+    for (int b = 0; b < 4; b++)
+	out[4 + b] = (uint8_t)(indices >> (8 * b));
+}
+
+// BC4 block (also the alpha half of BC3 and each half of BC5), eight-value
+// mode between the block's extremes.
+static void EncodeSingleChannelBlock(const uint8_t values[16], uint8_t out[8])
+{
+    uint8_t a0 = *std::max_element(values, values + 16);
+    uint8_t a1 = *std::min_element(values, values + 16);
+    out[0] = a0;
+    out[1] = a1;
+    uint64_t indices = 0;
+    if (a0 != a1) {
+	int palette[8];
+	palette[0] = a0;
+	palette[1] = a1;
+	for (int p = 2; p < 8; p++)
+	    palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+	for (int i = 0; i < 16; i++) {
+	    int best = 0, bestError = 1 << 30;
+	    for (int p = 0; p < 8; p++) {
+		int error = std::abs(values[i] - palette[p]);
+		if (error < bestError) {
+		    bestError = error;
+		    best = p;
+		}
+	    }
+	    indices |= (uint64_t)best << (3 * i);
+	}
+    }
+    for (int b = 0; b < 6; b++)
+	out[2 + b] = (uint8_t)(indices >> (8 * b));
+}
+
+static int BlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+static void EncodeLevel(const Image &image, BlockFormat format,
+			std::vector<uint8_t> &out)
+{
+    for (int by = 0; by < image.height; by += 4) {
+	for (int bx = 0; bx < image.width; bx += 4) {
+	    uint8_t block[16][4];
+	    for (int i = 0; i < 16; i++)
+		std::memcpy(block[i], image.Pixel(bx + i % 4, by + i / 4),
+			    4);
+	    uint8_t encoded[16];
+	    uint8_t channel[16];
+	    switch (format) {
+	    case BlockFormat::BC1:
+		EncodeColorBlock(block, encoded);
+		break;
+	    case BlockFormat::BC3:
+		for (int i = 0; i < 16; i++)
+		    channel[i] = block[i][3];
+		EncodeSingleChannelBlock(channel, encoded);
+		EncodeColorBlock(block, encoded + 8);
+		break;
+	    case BlockFormat::BC4:
+		for (int i = 0; i < 16; i++)
+		    channel[i] = block[i][0];
+		EncodeSingleChannelBlock(channel, encoded);
+		break;
+	    default: // BC5
+		for (int i = 0; i < 16; i++)
+		    channel[i] = block[i][0];
+		EncodeSingleChannelBlock(channel, encoded);
+		for (int i = 0; i < 16; i++)
+		    channel[i] = block[i][1];
+		EncodeSingleChannelBlock(channel, encoded + 8);
+		break;
+	    }
+	    out.insert(out.end(), encoded, encoded + BlockBytes(format));
+	}
+    }
+}
+
+static bool WriteDDS(const std::string &path, BlockFormat format,
+		     const Image &base, const std::vector<uint8_t> &data,
+		     unsigned int levels)
+{
+    DDSHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = sizeof(DDSHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+		   DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = (uint32_t)base.height;
+    header.width = (uint32_t)base.width;
+    header.pitchOrLinearSize = (uint32_t)DDSLevelSize(
+	base.width, base.height, BlockBytes(format));
+    header.mipMapCount = levels;
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    switch (format) {
+    case BlockFormat::BC1:
+	header.pixelFormat.fourCC = DDSFourCC('D', 'X', 'T', '1');
+	break;
+    case BlockFormat::BC3:
+	header.pixelFormat.fourCC = DDSFourCC('D', 'X', 'T', '5');
+	break;
+    case BlockFormat::BC4:
+	header.pixelFormat.fourCC = DDSFourCC('A', 'T', 'I', '1');
+	break;
+    default:
+	header.pixelFormat.fourCC = DDSFourCC('A', 'T', 'I', '2');
+	break;
+    }
+    header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char *)&DDS_MAGIC, sizeof(DDS_MAGIC));
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)data.data(), data.size());
+    return (bool)out;
+}
+
+static const char *FormatName(BlockFormat format)
+{
+    switch (format) {
+    case BlockFormat::BC1:
+	return "BC1";
+    case BlockFormat::BC3:
+	return "BC3";
+    case BlockFormat::BC4:
+	return "BC4";
+    default:
+	return "BC5";
+    }
+}
+
+static bool Convert(const std::string &input, BlockFormat format)
+{
+    int width, height, components;
+    unsigned char *pixels =
+	stbi_load(input.c_str(), &width, &height, &components, 4);
+    if (!pixels) {
+	std::printf("%s: failed to load\n", input.c_str());
+	return false;
+    }
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.rgba.assign(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+
+    if (format == BlockFormat::Auto) {
+	if (components == 1)
+	    format = BlockFormat::BC4;
+	else
+	    format = BlockFormat::BC1;
+	if (components == 2 || components == 4) {
+	    for (size_t i = 3; i < image.rgba.size(); i += 4) {
+		if (image.rgba[i] != 255) {
+		    format = BlockFormat::BC3;
+		    break;
+		}
+	    }
+	}
+    }
+
+    std::vector<uint8_t> data;
+    unsigned int levels = 0;
+    Image level = image;
+    while (true) {
+	EncodeLevel(level, format, data);
+	levels++;
+	if (level.width == 1 && level.height == 1)
+	    break;
+	level = Downsample(level);
+    }
+
+    std::string output = input + ".dds";
+    if (!WriteDDS(output, format, image, data, levels)) {
+	std::printf("%s: failed to write\n", output.c_str());
+	return false;
+    }
+    // what the stb path would have uploaded: source channels plus mips
+    double uncompressed = (double)width * height * components * 4.0 / 3.0;
+    std::printf("%s: %dx%d, %d channels -> %s, %u levels, %.2f MiB -> %.2f "
+		"MiB (%.1fx)\n",
+		output.c_str(), width, height, components, FormatName(format),
+		levels, uncompressed / (1 << 20),
+		(double)data.size() / (1 << 20),
+		uncompressed / (double)data.size());
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BlockFormat format = BlockFormat::Auto;
+    int converted = 0, failed = 0;
+    // same orientation as the runtime loader, so blocks upload unchanged
+    stbi_set_flip_vertically_on_load(true);
+    for (int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if (arg == "--bc1")
+	    format = BlockFormat::BC1;
+	else if (arg == "--bc3")
+	    format = BlockFormat::BC3;
+	else if (arg == "--bc4")
+	    format = BlockFormat::BC4;
+	else if (arg == "--bc5")
+	    format = BlockFormat::BC5;
+	else if (Convert(arg, format))
+	    converted++;
+	else
+	    failed++;
+    }
+    if (converted + failed == 0) {
+	std::printf("usage: %s [--bc1|--bc3|--bc4|--bc5] <image>...\n",
+		    argv[0]);
+	return 1;
+    }
+    return failed == 0 ? 0 : 1;
+}